@@ -0,0 +1,358 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*
+ * Host micro-benchmarks of the CLI. The library is included as a source, so
+ * that its static functions (the line parser, Cli_getCommand) can be timed
+ * alone; the received lines come from a memory transport, and the output
+ * helpers write into it, discarding the bytes. Every result is a JSON line:
+ *     {"config":"default","bench":"parse","maxParam":10,"bufferSize":50,
+ *      "iterations":200000,"nsPerOp":85.2,"opsPerSecond":11737089,
+ *      "bytesPerSecond":410798122}
+ *
+ * Usage: cli-bench [iterations [output file]]; without a file the lines are
+ * written to stdout, with a file they are appended to it.
+ */
+
+#include "cli.c"
+
+#include <time.h>
+
+#ifndef BENCH_CONFIG
+#define BENCH_CONFIG                 "default"
+#endif
+
+#define BENCH_ITERATIONS             200000
+#define BENCH_NAME_SIZE              8
+#define BENCH_INPUT_SIZE             4096
+#define BENCH_COMMANDS               (CLI_MAX_EXTERNAL_COMMAND + CLI_MAX_EXTERNAL_MODULE)
+
+static FILE* Bench_file;
+static uint32_t Bench_iterations = BENCH_ITERATIONS;
+
+static Cli_Transport Bench_transport;
+static Cli_HostMemory Bench_memory;
+
+/** Names of the registered commands, the table only keeps the pointers. */
+static char Bench_names[BENCH_COMMANDS][BENCH_NAME_SIZE];
+static uint8_t Bench_numberOfNames = 0;
+
+/** Sink of the results, so that the timed calls are not optimized away. */
+static volatile uintptr_t Bench_sink;
+
+static uint64_t Bench_now (void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Write the result of a benchmark.
+ *
+ * @param name Name of the benchmark
+ * @param operations Operations timed
+ * @param elapsed Time of all the operations, in ns
+ * @param bytes Bytes handled by all the operations, 0 when not meaningful
+ */
+static void Bench_report (const char* name, uint64_t operations, uint64_t elapsed, uint64_t bytes)
+{
+    double seconds = (elapsed > 0) ? (elapsed / 1e9) : 1e-9;
+
+    fprintf(Bench_file,
+            "{\"config\":\"%s\",\"bench\":\"%s\",\"maxParam\":%d,\"bufferSize\":%d,"
+            "\"iterations\":%llu,\"nsPerOp\":%.1f,\"opsPerSecond\":%.0f,\"bytesPerSecond\":%.0f}\n",
+            BENCH_CONFIG,name,CLI_MAX_PARAM,LOCCIONI_CLI_BUFFER_SIZE,
+            (unsigned long long)operations,(double)elapsed / operations,
+            operations / seconds,bytes / seconds);
+}
+
+static void Bench_nop (void* device, int argc, char* argv[])
+{
+    (void)device;
+    (void)argv;
+    Bench_sink += argc;
+}
+
+/**
+ * Fill the tables of Cli_registerCommand and Cli_registerModule, so that
+ * the lookup works on the largest index.
+ */
+static void Bench_registerCommands (void)
+{
+    uint8_t i;
+
+    for (i = 0; i < CLI_MAX_EXTERNAL_COMMAND; ++i, ++Bench_numberOfNames)
+    {
+        snprintf(Bench_names[Bench_numberOfNames],BENCH_NAME_SIZE,"cmd%02u",i);
+        Cli_registerCommand(Bench_names[Bench_numberOfNames],"Benchmark command",Bench_nop);
+    }
+    for (i = 0; i < CLI_MAX_EXTERNAL_MODULE; ++i, ++Bench_numberOfNames)
+    {
+        snprintf(Bench_names[Bench_numberOfNames],BENCH_NAME_SIZE,"mod%02u",i);
+        Cli_registerModule(Bench_names[Bench_numberOfNames],"Benchmark module",0,Bench_nop);
+    }
+}
+
+/**
+ * Tokenize a line, as the bytes would arrive before CR LF: the command is
+ * searched when its name ends, so the lookup is part of the time.
+ */
+static void Bench_parse (const char* name, const char* line)
+{
+    uint16_t length = strlen(line);
+    uint64_t start;
+    uint32_t i;
+    uint16_t j;
+
+    start = Bench_now();
+    for (i = 0; i < Bench_iterations; ++i)
+    {
+        Cli_lineReset();
+        for (j = 0; j < length; ++j)
+            Cli_lineFeed(line[j]);
+        Cli_lineCommandEnd();
+        Bench_sink += Cli_context->numberOfParams;
+    }
+    Bench_report(name,Bench_iterations,Bench_now() - start,(uint64_t)Bench_iterations * length);
+}
+
+typedef const Cli_Command* (*Bench_LookupFunction)(const char* name);
+
+/**
+ * The lookup of the versions before the index: three linear scans, built-in
+ * commands, then commands and modules, matching the name as a prefix.
+ */
+static const Cli_Command* Bench_linearLookup (const char* name)
+{
+    uint8_t i;
+
+    for (i = 0; i < CLI_COMMAND_TABLE_SIZED; i++)
+    {
+        if (strncmp(name,Cli_commandTable[i].name,strlen(Cli_commandTable[i].name)) == 0)
+            return &Cli_commandTable[i];
+    }
+    for (i = 0; i < Cli_externalCommandIndex; i++)
+    {
+        if (strncmp(name,Cli_externalCommandTable[i].name,strlen(Cli_externalCommandTable[i].name)) == 0)
+            return &Cli_externalCommandTable[i];
+    }
+    for (i = 0; i < Cli_externalModuleIndex; i++)
+    {
+        if (strncmp(name,Cli_externalModuleTable[i].name,strlen(Cli_externalModuleTable[i].name)) == 0)
+            return &Cli_externalModuleTable[i];
+    }
+    return 0;
+}
+
+/**
+ * Search every built-in and registered name, and a missing one, with the
+ * tables full.
+ */
+static void Bench_lookup (const char* name, Bench_LookupFunction lookup)
+{
+    static const char* const builtin[] = {"help", "version", "status", "zzz"};
+    const uint8_t count = sizeof(builtin) / sizeof(builtin[0]);
+    uint64_t start;
+    uint32_t i;
+
+    start = Bench_now();
+    for (i = 0; i < Bench_iterations; ++i)
+    {
+        const char* text = ((i % (BENCH_COMMANDS + count)) < BENCH_COMMANDS) ?
+                Bench_names[i % (BENCH_COMMANDS + count)] :
+                builtin[i % (BENCH_COMMANDS + count) - BENCH_COMMANDS];
+
+        Bench_sink += (uintptr_t)lookup(text);
+    }
+    Bench_report(name,Bench_iterations,Bench_now() - start,0);
+}
+
+/**
+ * Look up and run every one of the registered commands and modules, with
+ * two parameters, as the line parser does when a line ends.
+ */
+static void Bench_dispatch (const char* name, Bench_LookupFunction lookup)
+{
+    char* argv[] = {0, "1", "2"};
+    const Cli_Command* cmd;
+    uint64_t start;
+    uint32_t i;
+
+    start = Bench_now();
+    for (i = 0; i < Bench_iterations; ++i)
+    {
+        argv[0] = Bench_names[i % BENCH_COMMANDS];
+        cmd = lookup(argv[0]);
+        Cli_dispatchCommand(cmd,3,argv);
+    }
+    Bench_report(name,Bench_iterations,Bench_now() - start,0);
+}
+
+/**
+ * Receive whole lines through Cli_check: the RX path, the parser, the
+ * dispatch of an empty command and the prompt, in commands and bytes per
+ * second.
+ */
+static void Bench_receive (void)
+{
+    static char input[BENCH_INPUT_SIZE];
+    uint32_t length = 0;
+    uint32_t lines = 0;
+    uint32_t rounds;
+    uint64_t start;
+    uint32_t i;
+
+    while ((length + 2 * BENCH_NAME_SIZE) < sizeof(input))
+    {
+        length += snprintf(input + length,sizeof(input) - length,"%s %u\r\n",
+                           Bench_names[lines % CLI_MAX_EXTERNAL_COMMAND],lines);
+        lines++;
+    }
+    rounds = (Bench_iterations + lines - 1) / lines;
+
+    start = Bench_now();
+    for (i = 0; i < rounds; ++i)
+    {
+        Bench_memory.input = input;
+        Bench_memory.inputLength = length;
+        Bench_memory.inputIndex = 0;
+        while (Bench_memory.inputIndex < length)
+            Cli_check();
+    }
+    Cli_flush();
+    Bench_report("receive",(uint64_t)rounds * lines,Bench_now() - start,(uint64_t)rounds * length);
+}
+
+static void Bench_outputStart (void)
+{
+    Cli_flush();
+    Bench_memory.outputLength = 0;
+}
+
+static void Bench_outputEnd (const char* name, uint64_t start)
+{
+    uint64_t elapsed;
+
+    Cli_flush();
+    elapsed = Bench_now() - start;
+    Bench_report(name,Bench_iterations,elapsed,Bench_memory.outputLength);
+}
+
+static void Bench_output (void)
+{
+    uint64_t start;
+    uint32_t i;
+
+    Bench_outputStart();
+    start = Bench_now();
+    for (i = 0; i < Bench_iterations; ++i)
+        Cli_sendStatusString("voltage","12.5","V");
+    Bench_outputEnd("sendStatusString",start);
+
+    Bench_outputStart();
+    start = Bench_now();
+    for (i = 0; i < Bench_iterations; ++i)
+        Cli_sendHelpString("cmd00","Benchmark command");
+    Bench_outputEnd("sendHelpString",start);
+
+    Bench_outputStart();
+    start = Bench_now();
+    for (i = 0; i < Bench_iterations; ++i)
+        Cli_sendStatusf("counter","%u",i);
+    Bench_outputEnd("sendStatusf",start);
+}
+
+/**
+ * Cli_printf against the sprintf into a buffer that it replaced, with the
+ * same format and the same output path.
+ */
+static void Bench_format (void)
+{
+    char buffer[LOCCIONI_CLI_LINE_SIZE];
+    uint64_t start;
+    uint32_t i;
+
+    Bench_outputStart();
+    start = Bench_now();
+    for (i = 0; i < Bench_iterations; ++i)
+        Cli_printf("%s %d 0x%04X %u\r\n","value",-1234,i & 0xFFFF,i);
+    Bench_outputEnd("printf",start);
+
+    Bench_outputStart();
+    start = Bench_now();
+    for (i = 0; i < Bench_iterations; ++i)
+    {
+        sprintf(buffer,"%s %d 0x%04X %u\r\n","value",-1234,i & 0xFFFF,i);
+        Cli_puts(buffer);
+    }
+    Bench_outputEnd("sprintf",start);
+}
+
+int main (int argc, char* argv[])
+{
+    char longLine[LOCCIONI_CLI_LINE_SIZE] = "cmd07";
+    uint8_t i;
+
+    Bench_file = stdout;
+    if (argc > 1)
+        Bench_iterations = strtoul(argv[1],0,10);
+    if (argc > 2)
+        Bench_file = fopen(argv[2],"a");
+    if ((Bench_iterations == 0) || (Bench_file == 0))
+    {
+        fprintf(stderr,"usage: %s [iterations [output file]]\n",argv[0]);
+        return 1;
+    }
+
+    /* The banner and the prompts are discarded. */
+    Cli_hostMemoryTransport(&Bench_transport,&Bench_memory);
+    Cli_initTransport(&Bench_transport);
+    Cli_context = &Cli_sessions[0];
+    Bench_registerCommands();
+
+    /* A command with every parameter it can take. */
+    for (i = 1; i < CLI_MAX_PARAM; ++i)
+        snprintf(longLine + strlen(longLine),sizeof(longLine) - strlen(longLine)," p%u",i);
+
+    Bench_parse("parse",longLine);
+    Bench_parse("parseQuoted","mod03 set \"a quoted value\" 12 0x1F");
+    Bench_parse("parseList","cmd01 1; cmd02 2; cmd03 3");
+    Bench_lookup("lookup",Cli_getCommand);
+    Bench_lookup("lookupLinear",Bench_linearLookup);
+    Bench_dispatch("dispatch",Cli_getCommand);
+    Bench_dispatch("dispatchLinear",Bench_linearLookup);
+    Bench_receive();
+    Bench_output();
+    Bench_format();
+
+    if (Bench_file != stdout)
+        fclose(Bench_file);
+    return 0;
+}
@@ -0,0 +1,765 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+#ifdef __NO_BOARD_H
+
+#define _GNU_SOURCE
+
+#include "cli.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+void Time_unixtimeToString (uint32_t unixtime, char* dateString)
+{
+    time_t t = unixtime;
+    struct tm date;
+
+    gmtime_r(&t,&date);
+    strftime(dateString,26,"%Y/%m/%d %H:%M:%S",&date);
+}
+
+bool Utility_isValidIp4Address (char* str)
+{
+    unsigned int a,b,c,d;
+    char end;
+
+    if (sscanf(str,"%u.%u.%u.%u%c",&a,&b,&c,&d,&end) != 4)
+        return FALSE;
+    return (a < 256) && (b < 256) && (c < 256) && (d < 256);
+}
+
+bool Utility_isValidMacAddress (char* str)
+{
+    unsigned int m[6];
+    char end;
+
+    if (strlen(str) != 17)
+        return FALSE;
+    return sscanf(str,"%2x:%2x:%2x:%2x:%2x:%2x%c",
+                  &m[0],&m[1],&m[2],&m[3],&m[4],&m[5],&end) == 6;
+}
+
+void NVIC_SystemReset (void)
+{
+    exit(EXIT_SUCCESS);
+}
+
+uint32_t Cli_hostClock (void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (uint32_t)now.tv_sec * 1000000000u + (uint32_t)now.tv_nsec;
+}
+
+uint32_t Cli_hostMilliseconds (void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC,&now);
+    return (uint32_t)now.tv_sec * 1000u + (uint32_t)(now.tv_nsec / 1000000);
+}
+
+static uint16_t Cli_hostRead (void* handle, char* data, uint16_t length)
+{
+    Cli_HostFd* fd = handle;
+    ssize_t n = read(fd->in,data,length);
+
+    return (n > 0) ? (uint16_t)n : 0;
+}
+
+static uint16_t Cli_hostWrite (void* handle, const char* data, uint16_t length)
+{
+    Cli_HostFd* fd = handle;
+    ssize_t n = write(fd->out,data,length);
+
+    if (n >= 0)
+        return (uint16_t)n;
+
+    /* Peer not ready: wait for room instead of spinning. */
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+    {
+        struct pollfd p = {.fd = fd->out, .events = POLLOUT};
+        poll(&p,1,-1);
+        return 0;
+    }
+    /* Peer closed: drop the data so the caller does not loop forever. */
+    return length;
+}
+
+static uint16_t Cli_hostAvailable (void* handle)
+{
+    Cli_HostFd* fd = handle;
+    int count = 0;
+
+    if ((ioctl(fd->in,FIONREAD,&count) < 0) || (count <= 0))
+        return 0;
+    return (count > UINT16_MAX) ? UINT16_MAX : (uint16_t)count;
+}
+
+static uint16_t Cli_hostWritable (void* handle)
+{
+    Cli_HostFd* fd = handle;
+    struct pollfd p = {.fd = fd->out, .events = POLLOUT};
+
+    /* The kernel does not report the free room: offer a pipe-sized chunk. */
+    return ((poll(&p,1,0) == 1) && (p.revents & POLLOUT)) ? 512 : 0;
+}
+
+static const struct
+{
+    uint32_t baudrate;
+    speed_t speed;
+} Cli_hostSpeeds[] =
+{
+    {9600, B9600}, {19200, B19200}, {38400, B38400}, {57600, B57600},
+    {115200, B115200}, {230400, B230400},
+#ifdef B460800
+    {460800, B460800},
+#endif
+#ifdef B921600
+    {921600, B921600},
+#endif
+#ifdef B1000000
+    {1000000, B1000000},
+#endif
+#ifdef B1500000
+    {1500000, B1500000},
+#endif
+#ifdef B2000000
+    {2000000, B2000000},
+#endif
+#ifdef B3000000
+    {3000000, B3000000},
+#endif
+};
+
+/**
+ * A serial port gets the termios speed; sockets and pipes have no rate,
+ * so every rate is accepted and nothing changes.
+ */
+static bool Cli_hostSetBaudrate (void* handle, uint32_t baudrate, bool apply)
+{
+    Cli_HostFd* fd = handle;
+    struct termios options;
+    size_t i;
+
+    if (!isatty(fd->out))
+        return TRUE;
+
+    for (i = 0; i < (sizeof(Cli_hostSpeeds) / sizeof(Cli_hostSpeeds[0])); ++i)
+    {
+        if (Cli_hostSpeeds[i].baudrate == baudrate)
+            break;
+    }
+    if (i == (sizeof(Cli_hostSpeeds) / sizeof(Cli_hostSpeeds[0])))
+        return FALSE;
+    if (!apply)
+        return TRUE;
+
+    if (tcgetattr(fd->out,&options) < 0)
+        return FALSE;
+    cfsetispeed(&options,Cli_hostSpeeds[i].speed);
+    cfsetospeed(&options,Cli_hostSpeeds[i].speed);
+    /* TCSADRAIN: the bytes already written go out at the old rate. */
+    return tcsetattr(fd->out,TCSADRAIN,&options) == 0;
+}
+
+void Cli_hostFdTransport (Cli_Transport* transport, Cli_HostFd* fd)
+{
+    fcntl(fd->in,F_SETFL,fcntl(fd->in,F_GETFL) | O_NONBLOCK);
+
+    transport->handle    = fd;
+    transport->read      = Cli_hostRead;
+    transport->write     = Cli_hostWrite;
+    transport->available = Cli_hostAvailable;
+    transport->writable  = Cli_hostWritable;
+    transport->setBaudrate = Cli_hostSetBaudrate;
+}
+
+static uint16_t Cli_hostMemoryRead (void* handle, char* data, uint16_t length)
+{
+    Cli_HostMemory* memory = handle;
+    uint32_t left = memory->inputLength - memory->inputIndex;
+
+    if (length > left)
+        length = left;
+    memcpy(data,&memory->input[memory->inputIndex],length);
+    memory->inputIndex += length;
+    return length;
+}
+
+static uint16_t Cli_hostMemoryWrite (void* handle, const char* data, uint16_t length)
+{
+    Cli_HostMemory* memory = handle;
+    uint32_t copy = 0;
+
+    if ((memory->output != 0) && (memory->outputLength < memory->outputSize))
+    {
+        copy = memory->outputSize - memory->outputLength;
+        if (copy > length)
+            copy = length;
+        memcpy(&memory->output[memory->outputLength],data,copy);
+    }
+    /* Bytes beyond the output buffer are counted and discarded. */
+    memory->outputLength += length;
+    return length;
+}
+
+static uint16_t Cli_hostMemoryAvailable (void* handle)
+{
+    Cli_HostMemory* memory = handle;
+    uint32_t left = memory->inputLength - memory->inputIndex;
+
+    return (left > 0xFFFF) ? 0xFFFF : left;
+}
+
+static uint16_t Cli_hostMemoryWritable (void* handle)
+{
+    (void)handle;
+    return 0xFFFF;
+}
+
+void Cli_hostMemoryTransport (Cli_Transport* transport, Cli_HostMemory* memory)
+{
+    transport->handle    = memory;
+    transport->read      = Cli_hostMemoryRead;
+    transport->write     = Cli_hostMemoryWrite;
+    transport->available = Cli_hostMemoryAvailable;
+    transport->writable  = Cli_hostMemoryWritable;
+    transport->setBaudrate = 0;
+}
+
+static Cli_HostFd Cli_hostStdioFd = {STDIN_FILENO, STDOUT_FILENO};
+static Cli_Transport Cli_hostStdio;
+
+const Cli_Transport* Cli_hostStdioTransport (void)
+{
+    Cli_hostFdTransport(&Cli_hostStdio,&Cli_hostStdioFd);
+    return &Cli_hostStdio;
+}
+
+System_Errors Cli_hostOpenPty (Cli_HostFd* fd, char* name, uint16_t size)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+    if ((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0))
+    {
+        if (master >= 0) close(master);
+        return ERRORS_CLI_HOST_FAIL;
+    }
+
+    if (name && (ptsname_r(master,name,size) != 0))
+    {
+        close(master);
+        return ERRORS_CLI_HOST_FAIL;
+    }
+
+    fd->in  = master;
+    fd->out = master;
+    return ERRORS_NO_ERROR;
+}
+
+System_Errors Cli_hostOpenSocketPair (Cli_HostFd* fd, int* peer)
+{
+    int sv[2];
+
+    if (socketpair(AF_UNIX,SOCK_STREAM,0,sv) < 0)
+        return ERRORS_CLI_HOST_FAIL;
+
+    fd->in  = sv[0];
+    fd->out = sv[0];
+    *peer   = sv[1];
+    return ERRORS_NO_ERROR;
+}
+
+System_Errors Cli_hostOpenServer (uint16_t port, int* server)
+{
+    struct sockaddr_in address =
+    {
+        .sin_family      = AF_INET,
+        .sin_port        = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int enable = 1;
+    int fd = socket(AF_INET,SOCK_STREAM,0);
+
+    if (fd < 0)
+        return ERRORS_CLI_HOST_FAIL;
+
+    setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&enable,sizeof(enable));
+    if ((bind(fd,(struct sockaddr*)&address,sizeof(address)) < 0) ||
+        (listen(fd,LOCCIONI_CLI_SESSIONS) < 0))
+    {
+        close(fd);
+        return ERRORS_CLI_HOST_FAIL;
+    }
+    fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) | O_NONBLOCK);
+
+    /* A client that disconnects must not kill the process on write. */
+    signal(SIGPIPE,SIG_IGN);
+
+    *server = fd;
+    return ERRORS_NO_ERROR;
+}
+
+System_Errors Cli_hostAccept (int server, Cli_HostFd* fd)
+{
+    int client = accept(server,0,0);
+
+    if (client < 0)
+        return ERRORS_CLI_HOST_FAIL;
+
+    fd->in  = client;
+    fd->out = client;
+    return ERRORS_NO_ERROR;
+}
+
+bool Cli_hostIsClosed (const Cli_HostFd* fd)
+{
+    struct pollfd p = {.fd = fd->in, .events = POLLIN};
+    char c;
+
+    if ((poll(&p,1,0) != 1) || !(p.revents & (POLLIN | POLLHUP | POLLERR)))
+        return FALSE;
+
+    /* Readable with nothing to read: end of file. */
+    return (p.revents & (POLLHUP | POLLERR)) || (recv(fd->in,&c,1,MSG_PEEK) == 0);
+}
+
+#if LOCCIONI_CLI_PARAMETERS == 1
+
+static bool Cli_hostStorageRead (void* handle, uint32_t address, void* data, uint16_t length)
+{
+    Cli_HostStorage* file = handle;
+
+    return pread(file->fd,data,length,address) == length;
+}
+
+static bool Cli_hostStorageWrite (void* handle, uint32_t address, const void* data, uint16_t length)
+{
+    Cli_HostStorage* file = handle;
+    uint8_t old[256];
+    const uint8_t* bytes = data;
+    uint16_t chunk;
+    uint16_t i;
+
+    while (length > 0)
+    {
+        chunk = (length > sizeof(old)) ? sizeof(old) : length;
+        if (pread(file->fd,old,chunk,address) != chunk)
+            return FALSE;
+        /* Programming only clears bits. */
+        for (i = 0; i < chunk; ++i)
+            old[i] &= bytes[i];
+        if (pwrite(file->fd,old,chunk,address) != chunk)
+            return FALSE;
+
+        file->bytesWritten += chunk;
+        address += chunk;
+        bytes   += chunk;
+        length  -= chunk;
+    }
+    return TRUE;
+}
+
+static bool Cli_hostStorageErase (void* handle, uint8_t bank)
+{
+    Cli_HostStorage* file = handle;
+    uint8_t erased[256];
+    uint32_t offset;
+    uint32_t chunk;
+
+    memset(erased,0xFF,sizeof(erased));
+    for (offset = 0; offset < file->size; offset += chunk)
+    {
+        chunk = file->size - offset;
+        if (chunk > sizeof(erased))
+            chunk = sizeof(erased);
+        if (pwrite(file->fd,erased,chunk,bank * file->size + offset) != (ssize_t)chunk)
+            return FALSE;
+    }
+    file->erases++;
+    return TRUE;
+}
+
+System_Errors Cli_hostFileStorage (Cli_Storage* storage, Cli_HostStorage* file, const char* path, uint32_t size)
+{
+    struct stat status;
+    int fd = open(path,O_RDWR | O_CREAT,0644);
+
+    if (fd < 0)
+        return ERRORS_CLI_HOST_FAIL;
+
+    file->fd           = fd;
+    file->size         = size;
+    file->bytesWritten = 0;
+    file->erases       = 0;
+
+    /* A new file starts erased. */
+    if ((fstat(fd,&status) < 0) ||
+        ((status.st_size < 2 * (off_t)size) &&
+         (!Cli_hostStorageErase(file,0) || !Cli_hostStorageErase(file,1))))
+    {
+        close(fd);
+        return ERRORS_CLI_HOST_FAIL;
+    }
+    file->erases = 0;
+
+    storage->handle = file;
+    storage->size   = size;
+    storage->read   = Cli_hostStorageRead;
+    storage->write  = Cli_hostStorageWrite;
+    storage->erase  = Cli_hostStorageErase;
+    return ERRORS_NO_ERROR;
+}
+
+#endif /* LOCCIONI_CLI_PARAMETERS */
+
+#if LOCCIONI_CLI_TRANSFER == 1
+
+#define CLI_HOST_PACKET_NONE         0 /**< Timeout */
+#define CLI_HOST_PACKET_READY        1
+#define CLI_HOST_PACKET_LINE         2 /**< A text line ended outside the packets */
+#define CLI_HOST_PACKET_CLOSED       3
+
+static uint16_t Cli_hostCrc16 (uint16_t crc, uint8_t data)
+{
+    uint8_t i;
+
+    crc ^= (uint16_t)data << 8;
+    for (i = 0; i < 8; ++i)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+    return crc;
+}
+
+static bool Cli_hostWriteAll (int fd, const void* data, uint32_t length)
+{
+    struct pollfd p = {.fd = fd, .events = POLLOUT};
+    const uint8_t* bytes = data;
+    ssize_t sent;
+
+    while (length > 0)
+    {
+        sent = write(fd,bytes,length);
+        if (sent < 0)
+        {
+            if ((errno != EAGAIN) && (errno != EINTR))
+                return FALSE;
+            poll(&p,1,-1);
+            continue;
+        }
+        bytes  += sent;
+        length -= sent;
+    }
+    return TRUE;
+}
+
+static void Cli_hostPacketSend (int fd, uint8_t type, uint16_t sequence, const uint8_t* data, uint8_t length)
+{
+    uint8_t packet[LOCCIONI_CLI_TRANSFER_CHUNK + 7] =
+        {CLI_TRANSFER_SYNC, type, sequence & 0xFF, sequence >> 8, length};
+    uint16_t crc = 0xFFFF;
+    uint16_t i;
+
+    if (length > 0)
+        memcpy(&packet[5],data,length);
+    for (i = 1; i < (5 + length); ++i)
+        crc = Cli_hostCrc16(crc,packet[i]);
+    packet[5 + length] = crc & 0xFF;
+    packet[6 + length] = crc >> 8;
+    Cli_hostWriteAll(fd,packet,7 + length);
+}
+
+/**
+ * Wait a packet for at most LOCCIONI_CLI_TRANSFER_TIMEOUT ms. The packet
+ * is stored without the sync byte and the CRC: type, sequence, length and
+ * data. Bytes outside the packets are skipped. index keeps the bytes of a
+ * packet already read between the calls, 0 at the first one.
+ */
+static uint8_t Cli_hostPacketRead (int fd, uint8_t* packet, uint16_t* index)
+{
+    struct pollfd p = {.fd = fd, .events = POLLIN};
+    uint32_t start = Cli_hostMilliseconds();
+    uint32_t elapsed;
+    uint16_t crc;
+    uint16_t i;
+    uint8_t c;
+
+    for (;;)
+    {
+        elapsed = Cli_hostMilliseconds() - start;
+        if (elapsed >= LOCCIONI_CLI_TRANSFER_TIMEOUT)
+            return CLI_HOST_PACKET_NONE;
+        if (poll(&p,1,LOCCIONI_CLI_TRANSFER_TIMEOUT - elapsed) <= 0)
+            continue;
+        if (read(fd,&c,1) != 1)
+            return CLI_HOST_PACKET_CLOSED;
+
+        if (*index == 0)
+        {
+            if (c == CLI_TRANSFER_SYNC)
+                *index = 1;
+            else if (c == '\n')
+                return CLI_HOST_PACKET_LINE;
+            continue;
+        }
+
+        packet[*index - 1] = c;
+        (*index)++;
+        if ((*index == 5) && (packet[3] > LOCCIONI_CLI_TRANSFER_CHUNK))
+            *index = 0;
+        if ((*index < 5) || (*index < (7 + packet[3])))
+            continue;
+
+        *index = 0;
+        crc = 0xFFFF;
+        for (i = 0; i < (4 + packet[3]); ++i)
+            crc = Cli_hostCrc16(crc,packet[i]);
+        if ((packet[4 + packet[3]] == (crc & 0xFF)) && (packet[5 + packet[3]] == (crc >> 8)))
+            return CLI_HOST_PACKET_READY;
+    }
+}
+
+static void Cli_hostSendCommand (int fd, const char* command, const char* name)
+{
+    Cli_hostWriteAll(fd,command,strlen(command));
+    Cli_hostWriteAll(fd,name,strlen(name));
+    Cli_hostWriteAll(fd,"\r\n",2);
+}
+
+System_Errors Cli_hostDownload (int fd, const char* name, uint8_t* data, uint32_t size, uint32_t* length)
+{
+    uint8_t packet[LOCCIONI_CLI_TRANSFER_CHUNK + 6];
+    uint16_t index = 0;
+    uint8_t confirm[4];
+    uint16_t base = 0;
+    uint8_t bitmap = 0;
+    uint32_t total = 0;
+    uint32_t offset;
+    uint16_t sequence;
+    uint8_t retries = 0;
+    bool started = FALSE;
+    uint8_t result;
+
+    Cli_hostSendCommand(fd,"download ",name);
+
+    for (;;)
+    {
+        result = Cli_hostPacketRead(fd,packet,&index);
+        if (result == CLI_HOST_PACKET_CLOSED)
+            return ERRORS_CLI_HOST_FAIL;
+        if (result == CLI_HOST_PACKET_LINE)
+            continue;
+        if (result == CLI_HOST_PACKET_NONE)
+        {
+            if (++retries > LOCCIONI_CLI_TRANSFER_RETRIES)
+                break;
+            if (started)
+                Cli_hostPacketSend(fd,CLI_TRANSFER_ACK,base,&bitmap,1);
+            continue;
+        }
+
+        retries  = 0;
+        started  = TRUE;
+        sequence = packet[1] | (packet[2] << 8);
+
+        if (packet[0] == CLI_TRANSFER_ABORT)
+            return ERRORS_CLI_HOST_FAIL;
+
+        if ((packet[0] == CLI_TRANSFER_DATA) &&
+            (sequence >= base) && (sequence < (base + LOCCIONI_CLI_TRANSFER_WINDOW)))
+        {
+            offset = (uint32_t)sequence * LOCCIONI_CLI_TRANSFER_CHUNK;
+            if ((offset + packet[3]) > size)
+                break;
+            memcpy(&data[offset],&packet[4],packet[3]);
+            if ((offset + packet[3]) > total)
+                total = offset + packet[3];
+            bitmap |= 1 << (sequence - base);
+            while (bitmap & 1)
+            {
+                bitmap >>= 1;
+                base++;
+            }
+        }
+        else if ((packet[0] == CLI_TRANSFER_END) && (sequence == base) && (packet[3] == 4))
+        {
+            if ((packet[4] | (packet[5] << 8) | (packet[6] << 16) | ((uint32_t)packet[7] << 24)) != total)
+                break;
+
+            /* Confirm every END, until the result line comes. */
+            memcpy(confirm,&packet[4],4);
+            Cli_hostPacketSend(fd,CLI_TRANSFER_END,base,confirm,4);
+            for (retries = 0; retries <= LOCCIONI_CLI_TRANSFER_RETRIES; ++retries)
+            {
+                result = Cli_hostPacketRead(fd,packet,&index);
+                if ((result == CLI_HOST_PACKET_LINE) || (result == CLI_HOST_PACKET_CLOSED))
+                    break;
+                if ((result == CLI_HOST_PACKET_READY) && (packet[0] == CLI_TRANSFER_END))
+                    Cli_hostPacketSend(fd,CLI_TRANSFER_END,base,confirm,4);
+            }
+
+            *length = total;
+            return ERRORS_NO_ERROR;
+        }
+        Cli_hostPacketSend(fd,CLI_TRANSFER_ACK,base,&bitmap,1);
+    }
+
+    /* Nothing is sent to a CLI still in text mode. */
+    if (started)
+        Cli_hostPacketSend(fd,CLI_TRANSFER_ABORT,0,0,0);
+    return ERRORS_CLI_HOST_FAIL;
+}
+
+static void Cli_hostSendChunk (int fd, const uint8_t* data, uint32_t length, uint16_t chunk)
+{
+    uint32_t offset = (uint32_t)chunk * LOCCIONI_CLI_TRANSFER_CHUNK;
+
+    if ((length - offset) > LOCCIONI_CLI_TRANSFER_CHUNK)
+        length = offset + LOCCIONI_CLI_TRANSFER_CHUNK;
+    Cli_hostPacketSend(fd,CLI_TRANSFER_DATA,chunk,&data[offset],length - offset);
+}
+
+System_Errors Cli_hostUpload (int fd, const char* name, const uint8_t* data, uint32_t length)
+{
+    uint8_t packet[LOCCIONI_CLI_TRANSFER_CHUNK + 6];
+    uint16_t index = 0;
+    uint16_t chunks = (length + LOCCIONI_CLI_TRANSFER_CHUNK - 1) / LOCCIONI_CLI_TRANSFER_CHUNK;
+    uint16_t base = 0;
+    uint16_t next = 0;
+    uint16_t fast = 0xFFFF;
+    uint16_t limit = 0;
+    uint16_t sequence;
+    uint16_t chunk;
+    uint8_t bitmap = 0;
+    uint8_t retries = 0;
+    uint8_t size[4] = {length & 0xFF, (length >> 8) & 0xFF, (length >> 16) & 0xFF, length >> 24};
+    uint8_t last;
+    uint32_t progress = Cli_hostMilliseconds();
+    bool ready = FALSE;
+    bool end = FALSE;
+    uint8_t result;
+
+    if (length > CLI_TRANSFER_MAX_SIZE)
+        return ERRORS_CLI_HOST_FAIL;
+
+    Cli_hostSendCommand(fd,"upload ",name);
+
+    for (;;)
+    {
+        /* Chunks lost before acknowledged ones, then the new ones. */
+        for (chunk = base; chunk < limit; ++chunk)
+        {
+            if ((bitmap & (1 << (chunk - base))) == 0)
+                Cli_hostSendChunk(fd,data,length,chunk);
+        }
+        limit = 0;
+        while (ready && (next < chunks) && (next < (base + LOCCIONI_CLI_TRANSFER_WINDOW)))
+            Cli_hostSendChunk(fd,data,length,next++);
+        if (ready && (base == chunks) && !end)
+        {
+            Cli_hostPacketSend(fd,CLI_TRANSFER_END,chunks,size,4);
+            end = TRUE;
+        }
+
+        result = Cli_hostPacketRead(fd,packet,&index);
+        if (result == CLI_HOST_PACKET_CLOSED)
+            return ERRORS_CLI_HOST_FAIL;
+
+        if (result == CLI_HOST_PACKET_READY)
+        {
+            sequence = packet[1] | (packet[2] << 8);
+
+            if (packet[0] == CLI_TRANSFER_ABORT)
+                return ERRORS_CLI_HOST_FAIL;
+            if ((packet[0] == CLI_TRANSFER_END) && end && (sequence == chunks))
+            {
+                /* The CLI waits for repeated END before the result line. */
+                for (retries = 0; retries <= LOCCIONI_CLI_TRANSFER_RETRIES; ++retries)
+                {
+                    result = Cli_hostPacketRead(fd,packet,&index);
+                    if ((result == CLI_HOST_PACKET_LINE) || (result == CLI_HOST_PACKET_CLOSED))
+                        break;
+                }
+                return ERRORS_NO_ERROR;
+            }
+            if ((packet[0] == CLI_TRANSFER_ACK) && (packet[3] == 1) && (sequence >= base) && (sequence <= next))
+            {
+                /* The CLI repeats the same acknowledge while it waits. */
+                if (!ready || (sequence != base) || (packet[4] != bitmap))
+                {
+                    progress = Cli_hostMilliseconds();
+                    retries  = 0;
+                }
+                ready  = TRUE;
+                base   = sequence;
+                bitmap = packet[4];
+                if ((bitmap != 0) && (sequence != fast))
+                {
+                    fast = sequence;
+                    for (last = 7; (bitmap & (1 << last)) == 0; --last);
+                    limit = sequence + last;
+                }
+            }
+        }
+
+        if ((Cli_hostMilliseconds() - progress) >= LOCCIONI_CLI_TRANSFER_TIMEOUT)
+        {
+            progress = Cli_hostMilliseconds();
+            if (++retries > LOCCIONI_CLI_TRANSFER_RETRIES)
+                break;
+            if (end)
+                Cli_hostPacketSend(fd,CLI_TRANSFER_END,chunks,size,4);
+            else if (ready)
+                limit = next;
+        }
+    }
+
+    if (ready)
+        Cli_hostPacketSend(fd,CLI_TRANSFER_ABORT,0,0,0);
+    return ERRORS_CLI_HOST_FAIL;
+}
+
+#endif /* LOCCIONI_CLI_TRANSFER */
+
+#endif /* __NO_BOARD_H */
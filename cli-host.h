@@ -0,0 +1,202 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+/******************************************************************************
+ * Host backend of the CLI, used when __NO_BOARD_H is defined.
+ *
+ * This file replaces board.h and libohiboard with the few definitions the
+ * CLI needs, and provides file descriptor based transports so that the
+ * library can run on a Linux host over stdin/stdout, a pseudo terminal or a
+ * socket pair.
+ ******************************************************************************/
+
+#ifndef __LOCCIONI_CLI_HOST_H
+#define __LOCCIONI_CLI_HOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef TRUE
+#define TRUE                             true
+#endif
+#ifndef FALSE
+#define FALSE                            false
+#endif
+
+typedef enum
+{
+    ERRORS_NO_ERROR = 0,
+    ERRORS_CLI_HOST_FAIL,
+} System_Errors;
+
+#ifndef PROJECT_NAME
+#define PROJECT_NAME                     "CLI host"
+#endif
+#ifndef PROJECT_COPYRIGTH
+#define PROJECT_COPYRIGTH                "AEA s.r.l. Loccioni Group"
+#endif
+#ifndef PCB_VERSION_STRING
+#define PCB_VERSION_STRING               "host"
+#endif
+#ifndef FW_VERSION_STRING
+#define FW_VERSION_STRING                "host"
+#endif
+#ifndef FW_TIME_VERSION
+#define FW_TIME_VERSION                  0
+#endif
+
+void Time_unixtimeToString (uint32_t unixtime, char* dateString);
+bool Utility_isValidIp4Address (char* str);
+bool Utility_isValidMacAddress (char* str);
+
+/**
+ * On host the reboot command terminates the process.
+ */
+void NVIC_SystemReset (void);
+
+/**
+ * Monotonic clock in nanoseconds, wrapping every ~4 s: used to time the
+ * commands when LOCCIONI_CLI_STATISTICS is enabled.
+ */
+uint32_t Cli_hostClock (void);
+
+/**
+ * Monotonic clock in milliseconds, the time base of the watch command.
+ */
+uint32_t Cli_hostMilliseconds (void);
+
+struct _Cli_Transport;
+
+typedef struct _Cli_HostFd
+{
+    int in;
+    int out;
+} Cli_HostFd;
+
+/**
+ * Return the transport bound to the process standard input/output, used by
+ * Cli_init on host.
+ */
+const struct _Cli_Transport* Cli_hostStdioTransport (void);
+
+/**
+ * Fill a transport that reads from fd->in and writes to fd->out. Both file
+ * descriptors are switched to non-blocking read.
+ *
+ * @param transport The transport to fill
+ * @param fd The file descriptors, must remain valid while the transport is used
+ */
+void Cli_hostFdTransport (struct _Cli_Transport* transport, Cli_HostFd* fd);
+
+/**
+ * Memory buffers used as transport, to drive the CLI from a program (for
+ * example to measure the parser, the dispatch and the output) without any
+ * system call on the path.
+ */
+typedef struct _Cli_HostMemory
+{
+    const char* input;     /**< Bytes returned by read */
+    uint32_t inputLength;
+    uint32_t inputIndex;   /**< Next byte to read */
+
+    char* output;          /**< Written bytes, null to discard them */
+    uint32_t outputSize;
+    uint32_t outputLength; /**< Bytes written, counting the discarded ones */
+} Cli_HostMemory;
+
+/**
+ * Fill a transport that reads from memory->input and writes to
+ * memory->output. To feed new input, set input and inputLength and clear
+ * inputIndex.
+ */
+void Cli_hostMemoryTransport (struct _Cli_Transport* transport, Cli_HostMemory* memory);
+
+/**
+ * Open a pseudo terminal: the CLI side is returned into fd, the slave device
+ * name (to be opened by a terminal emulator) is copied into name.
+ */
+System_Errors Cli_hostOpenPty (Cli_HostFd* fd, char* name, uint16_t size);
+
+/**
+ * Create a connected socket pair: the CLI side is returned into fd, the
+ * other end (used by the client) into peer.
+ */
+System_Errors Cli_hostOpenSocketPair (Cli_HostFd* fd, int* peer);
+
+/**
+ * Listen for TCP connections on the loopback interface, standing in for
+ * the network sessions of the boards: every accepted connection can be
+ * bound with Cli_hostFdTransport and served with Cli_openSession.
+ */
+System_Errors Cli_hostOpenServer (uint16_t port, int* server);
+
+/**
+ * Accept a pending connection, without waiting.
+ *
+ * @return ERRORS_CLI_HOST_FAIL when no connection is pending
+ */
+System_Errors Cli_hostAccept (int server, Cli_HostFd* fd);
+
+/**
+ * Return TRUE when the other end has closed the connection, so that its
+ * session can be closed.
+ */
+bool Cli_hostIsClosed (const Cli_HostFd* fd);
+
+struct _Cli_Storage;
+
+/**
+ * Parameter storage kept into a file of two banks of size bytes, written
+ * like a NOR flash: a write can only clear bits, and the file is created
+ * erased (0xFF). The counters measure the storage traffic.
+ */
+typedef struct _Cli_HostStorage
+{
+    int fd;
+    uint32_t size;
+
+    uint32_t bytesWritten;
+    uint32_t erases;
+} Cli_HostStorage;
+
+System_Errors Cli_hostFileStorage (struct _Cli_Storage* storage, Cli_HostStorage* file, const char* path, uint32_t size);
+
+/**
+ * Run "download name" on the CLI at the other end of fd and receive the
+ * block into data, of size bytes. The length received is returned into
+ * length.
+ */
+System_Errors Cli_hostDownload (int fd, const char* name, uint8_t* data, uint32_t size, uint32_t* length);
+
+/**
+ * Run "upload name" on the CLI at the other end of fd and send it length
+ * bytes of data, at most CLI_TRANSFER_MAX_SIZE.
+ */
+System_Errors Cli_hostUpload (int fd, const char* name, const uint8_t* data, uint32_t length);
+
+#endif /* __LOCCIONI_CLI_HOST_H */
@@ -28,10 +28,16 @@
 
 #include "cli.h"
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/*
+ * Entries of Cli_registerCommand and Cli_registerModule: on a 32 bit core
+ * each one takes 44 bytes of RAM, 8 of them for the subcommand table and
+ * 16 for the legacy and typed handlers.
+ */
 #ifndef CLI_MAX_EXTERNAL_COMMAND
 #define CLI_MAX_EXTERNAL_COMMAND     50
 #endif
@@ -47,9 +53,187 @@
 #ifndef CLI_MAX_STATUS_CHAR_LINE
 #define CLI_MAX_STATUS_CHAR_LINE     10
 #endif
+/* Commands for every help page, 0 to print all of them at once. */
+#ifndef LOCCIONI_CLI_HELP_PAGE
+#define LOCCIONI_CLI_HELP_PAGE       16
+#endif
 #ifndef CLI_MAX_PARAM
 #define CLI_MAX_PARAM                10
 #endif
+/*
+ * Commands and parameters of a whole line, with ';' separated commands:
+ * every session keeps 8 bytes for a command and a pointer for a parameter.
+ */
+#ifndef CLI_MAX_LINE_COMMAND
+#define CLI_MAX_LINE_COMMAND         8
+#endif
+#ifndef CLI_MAX_LINE_PARAM
+#define CLI_MAX_LINE_PARAM           (2 * CLI_MAX_PARAM)
+#endif
+#ifndef LOCCIONI_CLI_RX_BUFFER_SIZE
+#define LOCCIONI_CLI_RX_BUFFER_SIZE  128
+#endif
+#ifndef CLI_RX_CHUNK_SIZE
+#define CLI_RX_CHUNK_SIZE            16
+#endif
+/*
+ * Output queue of every session, plus about 30 bytes of state and
+ * statistics. Set to 0 to write directly to the transport without queueing.
+ */
+#ifndef LOCCIONI_CLI_TX_BUFFER_SIZE
+#define LOCCIONI_CLI_TX_BUFFER_SIZE  256
+#endif
+#ifndef LOCCIONI_CLI_TX_POLICY
+#define LOCCIONI_CLI_TX_POLICY       CLI_TXPOLICY_BLOCK
+#endif
+#ifndef LOCCIONI_CLI_TX_MARKER
+#define LOCCIONI_CLI_TX_MARKER       "~\r\n"
+#endif
+/* Bytes formatted by Cli_printf before they are written out. */
+#ifndef CLI_PRINTF_CHUNK_SIZE
+#define CLI_PRINTF_CHUNK_SIZE        16
+#endif
+/* Bytes sent per Cli_check when the transport can not tell its free room. */
+#ifndef CLI_TX_CHUNK_SIZE
+#define CLI_TX_CHUNK_SIZE            16
+#endif
+
+/*
+ * Bytes stored between "batch begin" and "batch end", 0 to disable: every
+ * session reserves them, plus 5 bytes of state. 256 is a good start.
+ */
+#ifndef LOCCIONI_CLI_BATCH_SIZE
+#define LOCCIONI_CLI_BATCH_SIZE      0
+#endif
+
+/* Tab completion of command and subcommand names: code only, no RAM. */
+#ifndef LOCCIONI_CLI_COMPLETION
+#define LOCCIONI_CLI_COMPLETION      0
+#endif
+
+/*
+ * Bytes of the history of every session, browsed with up/down, 0 to remove
+ * it. Each session reserves them plus 5 bytes.
+ */
+#ifndef LOCCIONI_CLI_HISTORY_SIZE
+#define LOCCIONI_CLI_HISTORY_SIZE    0
+#endif
+
+/*
+ * The "baud" command, with the time the host has to confirm the new rate:
+ * 12 bytes of RAM for each session.
+ */
+#ifndef LOCCIONI_CLI_BAUD
+#define LOCCIONI_CLI_BAUD            0
+#endif
+#ifndef LOCCIONI_CLI_BAUD_TIMEOUT
+#define LOCCIONI_CLI_BAUD_TIMEOUT    3000
+#endif
+/* On host the rate is only nominal. */
+#ifndef LOCCIONI_CLI_BAUDRATE
+#define LOCCIONI_CLI_BAUDRATE        115200
+#endif
+
+#if LOCCIONI_CLI_PARAMETERS == 1
+#ifndef LOCCIONI_CLI_PARAMETERS_MAX
+#define LOCCIONI_CLI_PARAMETERS_MAX  16
+#endif
+/* Longest value of a parameter, in bytes. */
+#ifndef LOCCIONI_CLI_PARAMETER_SIZE
+#define LOCCIONI_CLI_PARAMETER_SIZE  32
+#endif
+/* The storage is written in multiples of this size, a power of two. */
+#ifndef LOCCIONI_CLI_STORAGE_ALIGN
+#define LOCCIONI_CLI_STORAGE_ALIGN   4
+#endif
+#endif
+
+#if LOCCIONI_CLI_TRANSFER == 1
+/* Data blocks registered with Cli_registerData. */
+#ifndef LOCCIONI_CLI_TRANSFER_ENDPOINTS
+#define LOCCIONI_CLI_TRANSFER_ENDPOINTS 4
+#endif
+#endif
+
+/*
+ * Status lines tracked by "watch", 0 to remove the command. Each session
+ * pays 5 bytes a line plus a copy of the line and of its parameters
+ * (about 300 bytes with 24 lines and the default sizes).
+ */
+#ifndef LOCCIONI_CLI_WATCH_LINES
+#define LOCCIONI_CLI_WATCH_LINES     0
+#endif
+#if LOCCIONI_CLI_LOG_SIZE > 0
+/* Bytes of a queued message, sender name included. */
+#ifndef LOCCIONI_CLI_LOG_MESSAGE_SIZE
+#define LOCCIONI_CLI_LOG_MESSAGE_SIZE 64
+#endif
+/* Senders with their own rate limit and counters. */
+#ifndef LOCCIONI_CLI_LOG_SOURCES
+#define LOCCIONI_CLI_LOG_SOURCES     8
+#endif
+#ifndef LOCCIONI_CLI_LOG_NAME_SIZE
+#define LOCCIONI_CLI_LOG_NAME_SIZE   12
+#endif
+/* Default messages per second of each sender, 0 unlimited. */
+#ifndef LOCCIONI_CLI_LOG_RATE
+#define LOCCIONI_CLI_LOG_RATE        10
+#endif
+#endif
+
+#if (LOCCIONI_CLI_WATCH_LINES > 0) || (LOCCIONI_CLI_LOG_SIZE > 0) || (LOCCIONI_CLI_BAUD == 1) || \
+    (LOCCIONI_CLI_TRANSFER == 1) || (LOCCIONI_CLI_PARAMETERS == 1)
+#ifndef LOCCIONI_CLI_MILLISECONDS
+#if defined (__NO_BOARD_H)
+#define LOCCIONI_CLI_MILLISECONDS()  Cli_hostMilliseconds()
+#else
+#define LOCCIONI_CLI_MILLISECONDS()  System_currentTick()
+#endif
+#endif
+#endif
+
+#if LOCCIONI_CLI_FRAMED == 1
+/* Maximum decoded size of a received frame, CRC included. */
+#ifndef LOCCIONI_CLI_FRAME_SIZE
+#define LOCCIONI_CLI_FRAME_SIZE      64
+#endif
+#endif
+
+#if LOCCIONI_CLI_STATISTICS == 1
+#ifndef LOCCIONI_CLI_STATISTICS_CLOCK
+#if defined (__NO_BOARD_H)
+#define LOCCIONI_CLI_STATISTICS_CLOCK()  Cli_hostClock()
+#define LOCCIONI_CLI_STATISTICS_UNIT     "ns"
+#elif defined (LIBOHIBOARD_K64F12)     || \
+      defined (LIBOHIBOARD_KV31F12)
+#define CLI_STATISTICS_DWT               1
+#define LOCCIONI_CLI_STATISTICS_CLOCK()  (DWT->CYCCNT)
+#define LOCCIONI_CLI_STATISTICS_UNIT     "cycles"
+#else
+#define LOCCIONI_CLI_STATISTICS_CLOCK()  0
+#endif
+#endif
+#ifndef LOCCIONI_CLI_STATISTICS_UNIT
+#define LOCCIONI_CLI_STATISTICS_UNIT     "ticks"
+#endif
+#endif
+
+/*
+ * The UART receive interrupt can be used only on microcontrollers whose
+ * Uart_Config has the callbackRx field.
+ */
+#if defined (LIBOHIBOARD_K64F12)     || \
+    defined (LIBOHIBOARD_KV31F12)
+#ifndef LOCCIONI_CLI_RX_INTERRUPT
+#define LOCCIONI_CLI_RX_INTERRUPT    1
+#endif
+#else
+#undef  LOCCIONI_CLI_RX_INTERRUPT
+#define LOCCIONI_CLI_RX_INTERRUPT    0
+#endif
+
+#define CLI_CTRL_C                   0x03
+#define CLI_ESCAPE                   0x1B
 
 #define CLI_BOARD_STRING             "Board"
 #define CLI_FIRMWARE_STRING          "Firmware"
@@ -60,55 +244,464 @@ char* Cli_wrongCmd      = "ERR: Unrecognized command";
 char* Cli_wrongParam    = "ERR: Wrong parameters";
 char* Cli_doneCmd       = "Command done!";
 char* Cli_notConfigMode = "ERR: You are not in configuration mode!";
+char* Cli_notFoundCmd   = "ERR: Command not found!";
+char* Cli_failedCmd     = "ERR: Command failed!";
+char* Cli_abortedCmd    = "ERR: Command aborted!";
+
+#if LOCCIONI_CLI_LINE_SIZE > 255
+#error "LOCCIONI_CLI_LINE_SIZE must fit into uint8_t"
+#endif
+
+typedef struct _Cli_LineCommand
+{
+    const struct _Cli_Command* cmd; /**< Resolved when the name ends */
+    uint8_t firstParam;             /**< Index into the session params */
+    uint8_t numberOfParams;
+    bool wrongParam;                /**< More than CLI_MAX_PARAM parameters */
+} Cli_LineCommand;
+
+#if LOCCIONI_CLI_LEGACY_HANDLER == 1
+/** Copy of the parameters for handlers registered with Cli_addCommand. */
+static char Cli_legacyParams[CLI_MAX_PARAM][LOCCIONI_CLI_BUFFER_SIZE];
+#endif
+
+#if LOCCIONI_CLI_STATISTICS == 1
+/** Bytes written by the commands, see Cli_dispatchCommand. */
+static uint32_t Cli_outputBytes = 0;
+#endif
+
+#if LOCCIONI_CLI_WATCH_LINES > 0
+typedef enum
+{
+    CLI_WATCH_OFF,    /**< No watched command is running */
+    CLI_WATCH_DRAW,   /**< First run: the output is sent and its rows counted */
+    CLI_WATCH_REDRAW, /**< Following runs: only changed status lines are sent */
+} Cli_WatchState;
+#endif
+
+/*
+ * Session state: every transport served by the CLI has its own line, task,
+ * batch, output queue and framed state, while the commands are shared.
+ */
+struct _Cli_Context
+{
+    /** Every byte read or written by the session goes through it. */
+    const Cli_Transport* transport;
+
+    /** The line as received, kept for backspace and batch blocks. */
+    char buffer[LOCCIONI_CLI_LINE_SIZE];
+    uint8_t bufferIndex;
+
+    /**
+     * Parameters of the current line, tokenized while the bytes arrive:
+     * every one is a null terminated string into tokens, without
+     * separators and double quotes.
+     */
+    char tokens[LOCCIONI_CLI_LINE_SIZE];
+    uint8_t tokensIndex;
+    char* params[CLI_MAX_LINE_PARAM];
+    uint8_t numberOfParams;
+
+    /** Commands of the current line: the last one is still open. */
+    Cli_LineCommand lineCommands[CLI_MAX_LINE_COMMAND];
+    uint8_t numberOfCommands;
+
+    bool isStringOpen;
+    bool isParamOpen;
+    /** Too many commands or parameters: the line is refused. */
+    bool lineOverflow;
+    /** State of the escape sequence being received, 0 outside of it. */
+    uint8_t escape;
+    uint8_t escapeParameter;
+#if LOCCIONI_CLI_EDITOR == 1
+    /** Position of the terminal cursor into buffer. */
+    uint8_t cursor;
+    bool overwrite;
+    bool echo;
+    bool lastCr;
+#endif
+
+#if LOCCIONI_CLI_HISTORY_SIZE > 0
+    /** Ring of the last lines, each ended by '\0'. */
+    char history[LOCCIONI_CLI_HISTORY_SIZE];
+    uint16_t historyHead;
+    uint16_t historyLength;
+    /** Line of the history shown, 0 when the line is a new one. */
+    uint8_t historyIndex;
+#endif
+
+    Cli_RxStatistics rxStatistics;
+
+    /** Set by Cli_sendError: the running command has failed. */
+    bool commandError;
+    /** The running command can start a task that goes on in the background. */
+    bool background;
+
+    /**
+     * Command that continues in the following Cli_check calls: it is idle
+     * when the function is null.
+     */
+    Cli_Task task;
+    /** Last progress sent to the terminal. */
+    uint8_t taskProgress;
+    /** A whole line has been received while the task was running. */
+    bool linePending;
+    /** Bytes read from the transport but not processed, see Cli_receive. */
+    char rxCarry[CLI_RX_CHUNK_SIZE];
+    uint8_t rxCarryLength;
+
+#if LOCCIONI_CLI_BAUD == 1
+    /** Rate of the transport, and the one restored without confirmation. */
+    uint32_t baudrate;
+    uint32_t baudPrevious;
+    uint32_t baudStart;
+#endif
+
+#if LOCCIONI_CLI_TRANSFER == 1
+    /** TRUE while "download" or "upload" runs: the input is read as packets. */
+    bool transferMode;
+    bool transferSending;
+    bool transferEnd;
+    const struct _Cli_DataEndpoint* transferData;
+    uint32_t transferSize;
+    uint16_t transferChunks;
+    /** First chunk not acknowledged, and the next one never sent. */
+    uint16_t transferBase;
+    uint16_t transferNext;
+    /** Chunks after the base already received, bit 0 is the base. */
+    uint8_t transferBitmap;
+    /** Base of the last fast retransmission. */
+    uint16_t transferFast;
+    uint32_t transferLast;
+    uint8_t transferRetries;
+    Cli_TaskStatus transferStatus;
+
+    uint8_t transferPacket[LOCCIONI_CLI_TRANSFER_CHUNK + 6];
+    uint16_t transferIndex;
+#endif
+
+    /** Range of the help page being sent. */
+    uint8_t helpFirst;
+    uint8_t helpEnd;
+    uint8_t helpPage;
+    uint8_t helpPages;
+
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    Cli_OutputFormat outputFormat;
+    /** A line is running: its record is sent when it ends. */
+    bool recordPending;
+    /** JSON object of the line opened, or already sent. */
+    bool recordOpen;
+    bool recordSent;
+    /** A value is being written: it ends with a quote. */
+    bool fieldOpen;
+    /** Line end held back, sent only if the value goes on. */
+    bool recordNewline;
+#if LOCCIONI_CLI_EDITOR == 1
+    /** Echo restored when the text output comes back. */
+    bool textEcho;
+#endif
+#endif
+
+#if LOCCIONI_CLI_WATCH_LINES > 0
+    /** Command run by watch, with a copy of its parameters. */
+    const struct _Cli_Command* watchCommand;
+    char watchTokens[LOCCIONI_CLI_LINE_SIZE];
+    char* watchParams[CLI_MAX_PARAM];
+    uint8_t watchNumberOfParams;
+    uint32_t watchPeriod;
+    uint32_t watchLast;
+
+    Cli_WatchState watchState;
+    uint8_t watchLine;    /**< Status line being sent */
+    uint8_t watchRow;     /**< Screen row of the cursor while drawing */
+    uint8_t watchLastRow; /**< First row after the drawn output */
+    bool watchHashing;    /**< The output is hashed, not sent */
+    bool watchWrite;      /**< A changed line is being sent */
+    bool watchChanged;
+    uint32_t watchHash;
+    uint8_t watchRows[LOCCIONI_CLI_WATCH_LINES];
+    uint32_t watchHashes[LOCCIONI_CLI_WATCH_LINES];
+#endif
+
+#if LOCCIONI_CLI_BATCH_SIZE > 0
+    /**
+     * Lines received between "batch begin" and "batch end", each one null
+     * terminated.
+     */
+    char batchBuffer[LOCCIONI_CLI_BATCH_SIZE];
+    uint16_t batchIndex;
+    bool batchOpen;
+    bool batchOverflow;
+    bool batchRunning;
+#endif
+
+    /**
+     * TRUE when configuration mode is selected, FALSE for application
+     * mode.
+     */
+    bool configMode;
 
-static char Cli_buffer[LOCCIONI_CLI_BUFFER_SIZE];
-static uint8_t Cli_bufferIndex = 0;
+#if LOCCIONI_CLI_TX_BUFFER_SIZE > 0
+    /**
+     * Transmit ring buffer: every output function enqueues here and
+     * Cli_check sends the data when the transport is ready.
+     */
+    char txBuffer[LOCCIONI_CLI_TX_BUFFER_SIZE];
+    uint16_t txTail;
+    uint16_t txCount;
+    /** TRUE after an overflow with truncate policy, until the queue is empty. */
+    bool txTruncated;
 
-static char Cli_params[CLI_MAX_PARAM][LOCCIONI_CLI_BUFFER_SIZE];
-static uint8_t Cli_numberOfParams = 0;
+    Cli_TxPolicy txPolicy;
+    Cli_TxStatistics txStatistics;
+#endif
+
+#if LOCCIONI_CLI_FRAMED == 1
+    /** TRUE when the session speaks the framed protocol instead of the text one. */
+    bool framedMode;
+    /** TRUE while a reply frame is being sent: the output is encoded into it. */
+    bool frameReplyOpen;
+    uint16_t frameCrc;
+
+    uint8_t frameBuffer[LOCCIONI_CLI_FRAME_SIZE];
+    uint16_t frameIndex;
+    bool frameEscape;
+    bool frameOverflow;
+#endif
+};
 
-static char Cli_statusBuffer[LOCCIONI_CLI_BUFFER_SIZE];
+#if LOCCIONI_CLI_TX_BUFFER_SIZE > 0
+/* The first session can be set up before Cli_init. */
+static Cli_Context Cli_sessions[LOCCIONI_CLI_SESSIONS] = {{.txPolicy = LOCCIONI_CLI_TX_POLICY}};
+#else
+static Cli_Context Cli_sessions[LOCCIONI_CLI_SESSIONS];
+#endif
+static bool Cli_sessionOpen[LOCCIONI_CLI_SESSIONS];
 
 /**
- * This variable is used to store current CLI status: TRUE when configuration mode is
- * selected, FALSE for application mode.
+ * Session served now: Cli_check selects every open session in turn, and
+ * outside of it the output goes to the first one.
  */
-static bool Cli_configMode = FALSE;
+static Cli_Context* Cli_context = &Cli_sessions[0];
+
+static void Cli_functionHelp(void* device, int argc, char* argv[]);
+static void Cli_functionVersion(void* device, int argc, char* argv[]);
+static void Cli_functionStatus(void* device, int argc, char* argv[]);
+#if LOCCIONI_CLI_ETHERNET == 1
+static void Cli_networkShow (void* device, int argc, char* argv[]);
+static void Cli_networkAddress (void* device, int argc, char* argv[]);
+static void Cli_networkMac (void* device, int argc, char* argv[]);
+#endif
+#if LOCCIONI_CLI_PARAMETERS == 1
+static void Cli_parameterCompact (void* device, int argc, char* argv[]);
+static void Cli_parameterGet (void* device, int argc, char* argv[]);
+static void Cli_parameterList (void* device, int argc, char* argv[]);
+static void Cli_parameterSet (void* device, int argc, char* argv[]);
+static void Cli_parameterStatus (void* device, int argc, char* argv[]);
+#endif
+static void Cli_saveFlash (void* device, int argc, char* argv[]);
+static void Cli_reboot (void* device, int argc, char* argv[]);
+#if LOCCIONI_CLI_FRAMED == 1
+static void Cli_functionFramed (void* device, int argc, char* argv[]);
+#endif
+#if LOCCIONI_CLI_BATCH_SIZE > 0
+static void Cli_functionBatch (void* device, int argc, char* argv[]);
+#endif
+#if LOCCIONI_CLI_STATISTICS == 1
+static void Cli_functionStats (void* device, int argc, char* argv[]);
+#endif
+#if LOCCIONI_CLI_WATCH_LINES > 0
+static void Cli_functionWatch (void* device, int argc, char* argv[]);
+#endif
+#if LOCCIONI_CLI_LOG_SIZE > 0
+static void Cli_functionLog (void* device, int argc, char* argv[]);
+#endif
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+static void Cli_functionOutput (void* device, int argc, char* argv[]);
+#endif
+#if LOCCIONI_CLI_BAUD == 1
+static void Cli_functionBaud (void* device, int argc, char* argv[]);
+#endif
+#if LOCCIONI_CLI_TRANSFER == 1
+static void Cli_functionTransfer (void* device, int argc, char* argv[]);
+#endif
 
-static void Cli_functionHelp(void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]);
-static void Cli_functionVersion(void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]);
-static void Cli_functionStatus(void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]);
-static void Cli_networkConfiguration (void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]);
-static void Cli_saveFlash (void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]);
-static void Cli_reboot (void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]);
+typedef enum
+{
+    CLI_COMMANDTYPE_COMMAND = 0,
+    CLI_COMMANDTYPE_MODULE,
+} Cli_CommandType;
 
-typedef struct
+typedef struct _Cli_Command
 {
     char *name;
     char *description;
     void *device;
-    void (*cmdFunction)(void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]);
+    Cli_CommandFunction cmdFunction;
+    Cli_CommandType type;
+#if LOCCIONI_CLI_LEGACY_HANDLER == 1
+    /** Used when cmdFunction is null. */
+    Cli_LegacyCommandFunction legacyFunction;
+#endif
+#if LOCCIONI_CLI_FRAMED == 1
+    /** Binary handler used in framed mode, when null cmdFunction is used. */
+    Cli_FramedFunction framedFunction;
+#endif
+#if LOCCIONI_CLI_TYPED_ARGUMENTS == 1
+    /** Used when cmdFunction is null, with the schema of its arguments. */
+    Cli_TypedCommandFunction typedFunction;
+    const Cli_Argument* arguments;
+    uint8_t numberOfArguments;
+#endif
+    /** Sorted table of a module registered with Cli_registerModuleTable. */
+    const Cli_Subcommand* subcommands;
+    uint8_t numberOfSubcommands;
 } Cli_Command;
 
+static void Cli_runCommand (const Cli_Command* cmd, int argc, char* argv[]);
+
+#if LOCCIONI_CLI_ETHERNET == 1
+static const Cli_Subcommand Cli_networkSubcommands[] =
+{
+    {"gw"  , "x.x.x.x"          , "Set gateway address"          , TRUE , Cli_networkAddress},
+    {"ip"  , "x.x.x.x"          , "Set ip address"               , TRUE , Cli_networkAddress},
+    {"mac" , "yy:yy:yy:yy:yy:yy", "Set mac address, hexadecimal", TRUE , Cli_networkMac},
+    {"mask", "x.x.x.x"          , "Set network mask"             , TRUE , Cli_networkAddress},
+    {"show", 0                  , "Show network configuration"   , FALSE, Cli_networkShow},
+};
+#endif
+
+#if LOCCIONI_CLI_PARAMETERS == 1
+static const Cli_Subcommand Cli_parameterSubcommands[] =
+{
+    {"compact", 0           , "Rewrite the saved parameters into the other bank", TRUE , Cli_parameterCompact},
+    {"get"    , "name"      , "Print a parameter"                               , FALSE, Cli_parameterGet},
+    {"list"   , 0           , "Print the parameters, * if changed after save"   , FALSE, Cli_parameterList},
+    {"set"    , "name value", "Change a parameter, save to keep it"             , TRUE , Cli_parameterSet},
+    {"status" , 0           , "Storage usage and write statistics"              , FALSE, Cli_parameterStatus},
+};
+#endif
+
 const Cli_Command Cli_commandTable[] =
 {
-    {"help"      , "Print commands list", 0, Cli_functionHelp},
-    {"version"   , "Print actual version of board and firmware", 0, Cli_functionVersion},
-    {"status"    , "Print microcontroller status", 0, Cli_functionStatus},
+    {.name = "help"    , .cmdFunction = Cli_functionHelp    , .description = "Print commands list, or of one command"},
+    {.name = "version" , .cmdFunction = Cli_functionVersion , .description = "Print actual version of board and firmware"},
+    {.name = "status"  , .cmdFunction = Cli_functionStatus  , .description = "Print microcontroller status"},
 #if LOCCIONI_CLI_ETHERNET == 1
-    {"netconfig" , "Set/Get network configurations", 0, Cli_networkConfiguration},
+    {
+        .name                = "netconfig",
+        .description         = "Set/Get network configurations",
+        .type                = CLI_COMMANDTYPE_MODULE,
+        .subcommands         = Cli_networkSubcommands,
+        .numberOfSubcommands = sizeof Cli_networkSubcommands / sizeof Cli_networkSubcommands[0],
+    },
+#endif
+#if LOCCIONI_CLI_PARAMETERS == 1
+    {
+        .name                = "param",
+        .description         = "Get/Set parameters",
+        .type                = CLI_COMMANDTYPE_MODULE,
+        .subcommands         = Cli_parameterSubcommands,
+        .numberOfSubcommands = sizeof Cli_parameterSubcommands / sizeof Cli_parameterSubcommands[0],
+    },
+#endif
+    {.name = "save"    , .cmdFunction = Cli_saveFlash       , .description = "Save parameters into flash memory"},
+    {.name = "reboot"  , .cmdFunction = Cli_reboot          , .description = "Reboot system"},
+#if LOCCIONI_CLI_BATCH_SIZE > 0
+    {.name = "batch"   , .cmdFunction = Cli_functionBatch   , .description = "Queue lines until \"batch end\", then run them"},
 #endif
-    {"save"      , "Save parameters into flash memory", 0, Cli_saveFlash},
-    {"reboot"    , "Reboot system", 0, Cli_reboot},
+#if LOCCIONI_CLI_WATCH_LINES > 0
+    {.name = "watch"   , .cmdFunction = Cli_functionWatch   , .description = "Run a command periodically, redraw what changes"},
+#endif
+#if LOCCIONI_CLI_LOG_SIZE > 0
+    {.name = "log"     , .cmdFunction = Cli_functionLog     , .description = "Messages level, rate limit and drops"},
+#endif
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    {.name = "output"  , .cmdFunction = Cli_functionOutput  , .description = "Output for terminals or programs: text, json or csv"},
+#endif
+#if LOCCIONI_CLI_BAUD == 1
+    {.name = "baud"    , .cmdFunction = Cli_functionBaud    , .description = "Show or change the baud rate"},
+#endif
+#if LOCCIONI_CLI_TRANSFER == 1
+    {.name = "download", .cmdFunction = Cli_functionTransfer, .description = "Send a data block with CRC checked packets"},
+    {.name = "upload"  , .cmdFunction = Cli_functionTransfer, .description = "Receive a data block with CRC checked packets"},
+#endif
+#if LOCCIONI_CLI_STATISTICS == 1
+    {.name = "stats"   , .cmdFunction = Cli_functionStats   , .description = "Show commands statistics"},
+#endif
+#if LOCCIONI_CLI_FRAMED == 1
+    {.name = "framed"  , .cmdFunction = Cli_functionFramed  , .description = "Switch to framed binary protocol"},
+#endif
+};
+
+#define CLI_COMMAND_TABLE_SIZED         (sizeof Cli_commandTable / sizeof Cli_commandTable[0])
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+
+#define CLI_STATIC_PROTOTYPE(cmdName, cmdDescription, cmdFunction) \
+    void cmdFunction (void*, int, char*[]);
+#define CLI_STATIC_MODULE_PROTOTYPE(cmdName, cmdDescription, cmdDevice, cmdFunction) \
+    void cmdFunction (void*, int, char*[]);
+
+LOCCIONI_CLI_STATIC_COMMANDS(CLI_STATIC_PROTOTYPE, CLI_STATIC_MODULE_PROTOTYPE)
+
+#define CLI_STATIC_COMMAND(cmdName, cmdDescription, cmdHandler) \
+    {.name = cmdName, .description = cmdDescription, .cmdFunction = cmdHandler, .type = CLI_COMMANDTYPE_COMMAND},
+#define CLI_STATIC_MODULE(cmdName, cmdDescription, cmdDevice, cmdHandler) \
+    {.name = cmdName, .description = cmdDescription, .device = cmdDevice, .cmdFunction = cmdHandler, .type = CLI_COMMANDTYPE_MODULE},
+
+/**
+ * Commands declared at compile time with LOCCIONI_CLI_STATIC_COMMANDS: the
+ * table is const, so it is placed in flash and needs no RAM.
+ */
+const Cli_Command Cli_staticCommandTable[] =
+{
+    LOCCIONI_CLI_STATIC_COMMANDS(CLI_STATIC_COMMAND, CLI_STATIC_MODULE)
 };
 
+#define CLI_STATIC_COMMAND_TABLE_SIZED  (sizeof Cli_staticCommandTable / sizeof Cli_staticCommandTable[0])
+
+/**
+ * TRUE when the static table is in alphabetical order and can be searched
+ * with a binary search, checked by Cli_init.
+ */
+static bool Cli_staticCommandSorted = FALSE;
+
+#endif /* LOCCIONI_CLI_STATIC_COMMANDS */
+
+#if (CLI_MAX_EXTERNAL_COMMAND > 0) || (CLI_MAX_EXTERNAL_MODULE > 0)
+#define CLI_DYNAMIC_COMMANDS            1
+#else
+#define CLI_DYNAMIC_COMMANDS            0
+#endif
+
+#if CLI_MAX_EXTERNAL_COMMAND > 0
 static Cli_Command Cli_externalCommandTable[CLI_MAX_EXTERNAL_COMMAND];
 static uint8_t Cli_externalCommandIndex = 0;
+#endif
 
+#if CLI_MAX_EXTERNAL_MODULE > 0
 static Cli_Command Cli_externalModuleTable[CLI_MAX_EXTERNAL_MODULE];
 static uint8_t Cli_externalModuleIndex = 0;
+#endif
 
-#define CLI_COMMAND_TABLE_SIZED         (sizeof Cli_commandTable / sizeof Cli_commandTable[0])
+#if CLI_DYNAMIC_COMMANDS == 1
+/**
+ * Pointers to every command and module sorted by name, used by
+ * Cli_getCommand for a binary search.
+ */
+static const Cli_Command* Cli_commandIndex[CLI_COMMAND_TABLE_SIZED +
+                                           CLI_MAX_EXTERNAL_COMMAND +
+                                           CLI_MAX_EXTERNAL_MODULE];
+static uint8_t Cli_commandIndexSize = 0;
+#endif
+
+#ifndef __NO_BOARD_H
+
+#if LOCCIONI_CLI_RX_INTERRUPT == 1
+static void Cli_uartRxInterrupt (void);
+#endif
 
 static Uart_Config Cli_uartConfig = {
 
@@ -134,584 +727,5531 @@ static Uart_Config Cli_uartConfig = {
     defined (LIBOHIBOARD_KV31F12)
 
     .callbackTx = 0,
+#if LOCCIONI_CLI_RX_INTERRUPT == 1
+    .callbackRx = Cli_uartRxInterrupt,
+#else
     .callbackRx = 0,
+#endif
 
 #endif
 };
 
-static void Cli_getCommand (char* name, Cli_Command* cmdFound)
+#if LOCCIONI_CLI_RX_INTERRUPT == 1
+
+/**
+ * Receive ring buffer: written only by the UART interrupt (head) and read
+ * only by Cli_check (tail), so no lock is needed.
+ */
+static volatile char Cli_rxBuffer[LOCCIONI_CLI_RX_BUFFER_SIZE];
+static volatile uint16_t Cli_rxHead = 0;
+static volatile uint16_t Cli_rxTail = 0;
+/** Added to the statistics of the session bound to the UART. */
+static volatile uint32_t Cli_rxOverrun = 0;
+
+static void Cli_uartRxInterrupt (void)
 {
-    Cli_Command cmd = {name, NULL, NULL};
-    uint8_t i;
+    char c;
+    uint16_t next;
 
-    for (i = 0; i < CLI_COMMAND_TABLE_SIZED; i++)
+    while (Uart_isCharPresent(LOCCIONI_CLI_DEV))
     {
-        if (strncmp(name, Cli_commandTable[i].name, strlen(Cli_commandTable[i].name)) == 0)
-        {
-            cmdFound->name        = Cli_commandTable[i].name;
-            cmdFound->description = Cli_commandTable[i].description;
-            cmdFound->cmdFunction = Cli_commandTable[i].cmdFunction;
-            cmdFound->device      = Cli_commandTable[i].device;
-            return;
-        }
-    }
+        Uart_getChar(LOCCIONI_CLI_DEV, &c);
 
-    for (i = 0; i < Cli_externalCommandIndex; i++)
-    {
-        if (strncmp(name, Cli_externalCommandTable[i].name, strlen(Cli_externalCommandTable[i].name)) == 0)
-        {
-            cmdFound->name        = Cli_externalCommandTable[i].name;
-            cmdFound->description = Cli_externalCommandTable[i].description;
-            cmdFound->cmdFunction = Cli_externalCommandTable[i].cmdFunction;
-            cmdFound->device      = 0;
-            return;
-        }
-    }
+        next = Cli_rxHead + 1;
+        if (next == LOCCIONI_CLI_RX_BUFFER_SIZE) next = 0;
 
-    for (i = 0; i < Cli_externalModuleIndex; i++)
-    {
-        if (strncmp(name, Cli_externalModuleTable[i].name, strlen(Cli_externalModuleTable[i].name)) == 0)
+        if (next == Cli_rxTail)
         {
-            cmdFound->name        = Cli_externalModuleTable[i].name;
-            cmdFound->description = Cli_externalModuleTable[i].description;
-            cmdFound->cmdFunction = Cli_externalModuleTable[i].cmdFunction;
-            cmdFound->device      = Cli_externalModuleTable[i].device;
-            return;
+            Cli_rxOverrun++;
+            continue;
         }
+        Cli_rxBuffer[Cli_rxHead] = c;
+        Cli_rxHead = next;
     }
-    /* If we don't find any command, return null. */
-    cmdFound = 0;
 }
 
-static void Cli_prompt (void)
+static uint16_t Cli_uartRead (void* handle, char* data, uint16_t length)
 {
-    Uart_sendString(LOCCIONI_CLI_DEV, "\r\n$> ");
-    memset(Cli_buffer, 0, sizeof(Cli_buffer));
-    memset(Cli_params, 0, sizeof(Cli_params));
-    Cli_bufferIndex = 0;
+    uint16_t i = 0;
+    uint16_t tail = Cli_rxTail;
+
+    while ((i < length) && (tail != Cli_rxHead))
+    {
+        data[i++] = Cli_rxBuffer[tail];
+        if (++tail == LOCCIONI_CLI_RX_BUFFER_SIZE) tail = 0;
+    }
+    Cli_rxTail = tail;
+    return i;
 }
 
-static void Cli_sayHello (void)
+static uint16_t Cli_uartAvailable (void* handle)
 {
-    uint8_t i = 0;
+    uint16_t head = Cli_rxHead;
+    uint16_t tail = Cli_rxTail;
 
-    Uart_sendString(LOCCIONI_CLI_DEV, "\r\n");
-    for (i=0; i<CLI_MAX_CHARS_PER_LINE; ++i) Uart_putChar(LOCCIONI_CLI_DEV,'*');
-    Uart_sendString(LOCCIONI_CLI_DEV, "\r\n");
-    Uart_sendStringln(LOCCIONI_CLI_DEV, PROJECT_NAME);
-    Uart_sendStringln(LOCCIONI_CLI_DEV, PROJECT_COPYRIGTH);
-    for (i=0; i<CLI_MAX_CHARS_PER_LINE; ++i) Uart_putChar(LOCCIONI_CLI_DEV,'*');
-    Uart_sendString(LOCCIONI_CLI_DEV, "\r\n");
-    Cli_functionVersion(0,0,0);
-    for (i=0; i<CLI_MAX_CHARS_PER_LINE; ++i) Uart_putChar(LOCCIONI_CLI_DEV,'*');
-    Uart_sendString(LOCCIONI_CLI_DEV, "\r\n");
+    return (head >= tail) ? (head - tail) : (LOCCIONI_CLI_RX_BUFFER_SIZE - tail + head);
 }
 
-static void Cli_functionHelp (void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE])
-{
-    uint8_t i,j;
-    uint8_t blank = 0;
+#else
 
-    Cli_sayHello();
+static uint16_t Cli_uartRead (void* handle, char* data, uint16_t length)
+{
+    uint16_t i = 0;
 
-    for (i = 0; i < CLI_COMMAND_TABLE_SIZED; i++)
+    while ((i < length) && Uart_isCharPresent(LOCCIONI_CLI_DEV))
     {
-        blank = CLI_MAX_CMD_CHAR_LINE - strlen(Cli_commandTable[i].name);
-        Uart_sendString(LOCCIONI_CLI_DEV,Cli_commandTable[i].name);
-        for (j=0; j < blank; ++j) Uart_putChar(LOCCIONI_CLI_DEV,' ');
-        Uart_putChar(LOCCIONI_CLI_DEV,';');
-        Uart_sendStringln(LOCCIONI_CLI_DEV,Cli_commandTable[i].description);
+        Uart_getChar(LOCCIONI_CLI_DEV, &data[i++]);
     }
+    return i;
+}
 
-    // Print external command
-    for (i = 0; i < Cli_externalCommandIndex; i++)
-    {
-        blank = CLI_MAX_CMD_CHAR_LINE - strlen(Cli_externalCommandTable[i].name);
-        Uart_sendString(LOCCIONI_CLI_DEV,Cli_externalCommandTable[i].name);
-        for (j=0; j < blank; ++j) Uart_putChar(LOCCIONI_CLI_DEV,' ');
-        Uart_putChar(LOCCIONI_CLI_DEV,';');
-        Uart_sendStringln(LOCCIONI_CLI_DEV,Cli_externalCommandTable[i].description);
-    }
+static uint16_t Cli_uartAvailable (void* handle)
+{
+    return Uart_isCharPresent(LOCCIONI_CLI_DEV) ? 1 : 0;
+}
 
-    // Print external module and sub command
-    for (i = 0; i < Cli_externalModuleIndex; i++)
-    {
-        blank = CLI_MAX_CMD_CHAR_LINE - strlen(Cli_externalModuleTable[i].name);
-        Uart_sendString(LOCCIONI_CLI_DEV,Cli_externalModuleTable[i].name);
-        for (j=0; j < blank; ++j) Uart_putChar(LOCCIONI_CLI_DEV,' ');
-        Uart_putChar(LOCCIONI_CLI_DEV,';');
-        Uart_sendStringln(LOCCIONI_CLI_DEV,Cli_externalModuleTable[i].description);
+#endif /* LOCCIONI_CLI_RX_INTERRUPT */
 
-        // Print help menu of the module!
-        Cli_externalModuleTable[i].cmdFunction(Cli_externalModuleTable[i].device,1,0);
-    }
+static uint16_t Cli_uartWrite (void* handle, const char* data, uint16_t length)
+{
+    uint16_t i;
+
+    for (i = 0; i < length; ++i) Uart_putChar(LOCCIONI_CLI_DEV,data[i]);
+    return length;
 }
 
-static void Cli_functionVersion (void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE])
+#if LOCCIONI_CLI_BAUD == 1
+
+#ifndef LOCCIONI_CLI_UART_CLOCK
+#define LOCCIONI_CLI_UART_CLOCK()    Clock_getFrequency(CLOCK_BUS)
+#endif
+
+/**
+ * The UART rate is clock / (16 * SBR), with SBR of 13 bits: a rate is
+ * accepted when the nearest divider gives less than 3% of error. The UART
+ * is opened again, after the last byte has been sent.
+ */
+static bool Cli_uartSetBaudrate (void* handle, uint32_t baudrate, bool apply)
 {
-    uint8_t i,blank = 0;
-    char dateString[26];
+    uint32_t clock = LOCCIONI_CLI_UART_CLOCK();
+    uint32_t divider = (clock + 8 * baudrate) / (16 * baudrate);
+    uint32_t actual;
+    uint32_t error;
 
-    /* Board version */
-    blank = CLI_MAX_STATUS_CHAR_LINE - strlen(CLI_BOARD_STRING);
-    Uart_sendString(LOCCIONI_CLI_DEV,CLI_BOARD_STRING);
-    for (i=0; i < blank; ++i) Uart_putChar(LOCCIONI_CLI_DEV,' ');
-    Uart_putChar(LOCCIONI_CLI_DEV,':');
-    Uart_putChar(LOCCIONI_CLI_DEV,' ');
-    Uart_sendStringln(LOCCIONI_CLI_DEV, PCB_VERSION_STRING);
+    if ((divider == 0) || (divider > 8191))
+        return FALSE;
 
-    /* Firmware version */
-    Time_unixtimeToString(FW_TIME_VERSION,dateString);
-    blank = CLI_MAX_STATUS_CHAR_LINE - strlen(CLI_FIRMWARE_STRING);
-    Uart_sendString(LOCCIONI_CLI_DEV,CLI_FIRMWARE_STRING);
-    for (i=0; i < blank; ++i) Uart_putChar(LOCCIONI_CLI_DEV,' ');
-    Uart_putChar(LOCCIONI_CLI_DEV,':');
-    Uart_putChar(LOCCIONI_CLI_DEV,' ');
-    Uart_sendString(LOCCIONI_CLI_DEV, FW_VERSION_STRING);
-    Uart_sendString(LOCCIONI_CLI_DEV, " of ");
-    Uart_sendStringln(LOCCIONI_CLI_DEV,dateString);
+    actual = clock / (16 * divider);
+    error = (actual > baudrate) ? (actual - baudrate) : (baudrate - actual);
+    if ((error * 100) > (baudrate * 3))
+        return FALSE;
+
+    if (apply)
+    {
+        while (!Uart_isTransmissionComplete(LOCCIONI_CLI_DEV));
+        Uart_close(LOCCIONI_CLI_DEV);
+        Cli_uartConfig.baudrate = baudrate;
+        Uart_open(LOCCIONI_CLI_DEV,&Cli_uartConfig);
+    }
+    return TRUE;
 }
 
-static void Cli_functionStatus (void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE])
+#endif
+
+static const Cli_Transport Cli_uartTransport =
 {
-    uint8_t i;
+    .handle    = 0,
+    .read      = Cli_uartRead,
+    .write     = Cli_uartWrite,
+    .available = Cli_uartAvailable,
+    .writable  = 0,
+#if LOCCIONI_CLI_BAUD == 1
+    .setBaudrate = Cli_uartSetBaudrate,
+#endif
+};
 
-    for (i=0; i<CLI_MAX_CHARS_PER_LINE; ++i) Uart_putChar(LOCCIONI_CLI_DEV,'*');
-    Uart_sendString(LOCCIONI_CLI_DEV, "\r\n");
-    Uart_sendStringln(LOCCIONI_CLI_DEV, "System Status");
-    for (i=0; i<CLI_MAX_CHARS_PER_LINE; ++i) Uart_putChar(LOCCIONI_CLI_DEV,'*');
-    Uart_sendString(LOCCIONI_CLI_DEV, "\r\n");
+#endif /* __NO_BOARD_H */
 
-    Cli_functionVersion(0,0,0);
-}
 
-#if LOCCIONI_CLI_ETHERNET == 1
+#if LOCCIONI_CLI_TX_BUFFER_SIZE > 0
 
-static uint8_t* Cli_ipAddress      = 0;
-static uint8_t* Cli_gatewayAddress = 0;
-static uint8_t* Cli_maskAddress    = 0;
-static uint8_t* Cli_macAddress     = 0;
+#define CLI_TX_MARKER_SIZED          (sizeof(LOCCIONI_CLI_TX_MARKER) - 1)
 
-void Cli_setNetworkMemoryArray (uint8_t* ip, uint8_t* mask, uint8_t* gw, uint8_t* mac)
-{
-    Cli_ipAddress = ip;
-    Cli_gatewayAddress = gw;
-    Cli_maskAddress = mask;
-    Cli_macAddress = mac;
-}
 
-static void Cli_networkConfiguration (void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE])
+/**
+ * Move queued bytes to the transport.
+ *
+ * @param wait When TRUE, return only when the queue is empty
+ */
+static void Cli_txDrain (bool wait)
 {
-    uint8_t tmp[6];
+    uint16_t length;
+    uint16_t room;
+    uint16_t sent;
 
-    if (argc == 1)
+    while (Cli_context->txCount > 0)
     {
-        if (Cli_configMode)
+        length = LOCCIONI_CLI_TX_BUFFER_SIZE - Cli_context->txTail;
+        if (length > Cli_context->txCount) length = Cli_context->txCount;
+
+        if (!wait)
         {
-            Cli_sendHelpString("ip|gw|mask x.x.x.x","Set ip|gw|mask address");
-            Cli_sendHelpString("mac y:y:y:y:y:y","Set mac address");
+            room = (Cli_context->transport->writable) ?
+                   Cli_context->transport->writable(Cli_context->transport->handle) : CLI_TX_CHUNK_SIZE;
+            if (room == 0)
+                break;
+            if (length > room) length = room;
         }
-        Cli_sendHelpString("show","Show network configuration");
-        return;
-    }
-
-    if ((argc == 2) && (strcmp(argv[1], "show") == 0))
-    {
-        sprintf(Cli_statusBuffer,
-                "%d.%d.%d.%d",
-                Cli_ipAddress[0],
-                Cli_ipAddress[1],
-                Cli_ipAddress[2],
-                Cli_ipAddress[3]);
-        Cli_sendStatusString("ip",Cli_statusBuffer,0);
 
-        sprintf(Cli_statusBuffer,
-                "%d.%d.%d.%d",
-                Cli_gatewayAddress[0],
-                Cli_gatewayAddress[1],
-                Cli_gatewayAddress[2],
-                Cli_gatewayAddress[3]);
-        Cli_sendStatusString("gateway",Cli_statusBuffer,0);
+        sent = Cli_context->transport->write(Cli_context->transport->handle,&Cli_context->txBuffer[Cli_context->txTail],length);
 
-        sprintf(Cli_statusBuffer,
-                "%d.%d.%d.%d",
-                Cli_maskAddress[0],
-                Cli_maskAddress[1],
-                Cli_maskAddress[2],
-                Cli_maskAddress[3]);
-        Cli_sendStatusString("mask",Cli_statusBuffer,0);
+        Cli_context->txTail += sent;
+        if (Cli_context->txTail == LOCCIONI_CLI_TX_BUFFER_SIZE) Cli_context->txTail = 0;
+        Cli_context->txCount -= sent;
+        Cli_context->txStatistics.sent += sent;
 
-        sprintf(Cli_statusBuffer,
-                "%02X:%02X:%02X:%02X:%02X:%02X",
-                Cli_macAddress[0],
-                Cli_macAddress[1],
-                Cli_macAddress[2],
-                Cli_macAddress[3],
-                Cli_macAddress[4],
-                Cli_macAddress[5]);
-        Cli_sendStatusString("mac",Cli_statusBuffer,0);
-        return;
+        if (!wait && ((sent < length) || (Cli_context->transport->writable == 0)))
+            break;
     }
 
-    // The network can be configured only in debug mode
-    if ((argc == 3) && (Cli_configMode))
-    {
-        if (strcmp(argv[1], "ip") == 0)
-        {
-            if (Utility_isValidIp4Address(argv[2]))
-            {
-                sscanf(argv[2],
-                       "%d.%d.%d.%d",
-                       &tmp[0],
-                       &tmp[1],
-                       &tmp[2],
-                       &tmp[3]);
+    if (Cli_context->txCount == 0)
+        Cli_context->txTruncated = FALSE;
+}
 
-                for (uint8_t i = 0; i < 4; ++i) Cli_ipAddress[i] = tmp[i];
+static void Cli_txPush (const char* data, uint16_t length)
+{
+    uint16_t head;
+    uint16_t n;
 
-                LOCCIONI_CLI_DONECMD();
-                return;
-            }
-            else
+    while (length > 0)
+    {
+        head = Cli_context->txTail + Cli_context->txCount;
+        if (head >= LOCCIONI_CLI_TX_BUFFER_SIZE) head -= LOCCIONI_CLI_TX_BUFFER_SIZE;
+
+        n = LOCCIONI_CLI_TX_BUFFER_SIZE - head;
+        if (n > length) n = length;
+
+        memcpy(&Cli_context->txBuffer[head],data,n);
+        Cli_context->txCount += n;
+        data   += n;
+        length -= n;
+    }
+
+    if (Cli_context->txCount > Cli_context->txStatistics.highWater)
+        Cli_context->txStatistics.highWater = Cli_context->txCount;
+}
+
+static void Cli_writeRaw (const char* data, uint16_t length)
+{
+    uint16_t capacity;
+    uint16_t n;
+
+    /* Room for the marker is always kept with the truncate policy. */
+    capacity = LOCCIONI_CLI_TX_BUFFER_SIZE;
+    if (Cli_context->txPolicy == CLI_TXPOLICY_TRUNCATE)
+        capacity -= CLI_TX_MARKER_SIZED;
+
+    while (length > 0)
+    {
+        if (Cli_context->txTruncated)
+        {
+            Cli_context->txStatistics.dropped += length;
+            return;
+        }
+
+        if (Cli_context->txCount >= capacity)
+        {
+            switch (Cli_context->txPolicy)
             {
-                LOCCIONI_CLI_WRONGPARAM();
+            case CLI_TXPOLICY_BLOCK:
+                Cli_txDrain(TRUE);
+                continue;
+            case CLI_TXPOLICY_DROP:
+                Cli_context->txStatistics.dropped += length;
+                return;
+            case CLI_TXPOLICY_TRUNCATE:
+                Cli_txPush(LOCCIONI_CLI_TX_MARKER,CLI_TX_MARKER_SIZED);
+                Cli_context->txTruncated = TRUE;
+                Cli_context->txStatistics.dropped += length;
                 return;
             }
         }
 
-        if (strcmp(argv[1], "gw") == 0)
+        n = capacity - Cli_context->txCount;
+        if (n > length) n = length;
+
+        Cli_txPush(data,n);
+        data   += n;
+        length -= n;
+    }
+}
+
+void Cli_flush (void)
+{
+    Cli_txDrain(TRUE);
+}
+
+void Cli_setTxPolicy (Cli_TxPolicy policy)
+{
+    Cli_context->txPolicy = policy;
+}
+
+void Cli_getTxStatistics (Cli_TxStatistics* statistics)
+{
+    *statistics = Cli_context->txStatistics;
+    statistics->pending = Cli_context->txCount;
+}
+
+void Cli_resetTxStatistics (void)
+{
+    Cli_context->txStatistics.sent      = 0;
+    Cli_context->txStatistics.dropped   = 0;
+    Cli_context->txStatistics.highWater = Cli_context->txCount;
+}
+
+#else
+
+static void Cli_writeRaw (const char* data, uint16_t length)
+{
+    uint16_t sent;
+
+    while (length > 0)
+    {
+        sent = Cli_context->transport->write(Cli_context->transport->handle,data,length);
+        data   += sent;
+        length -= sent;
+    }
+}
+
+void Cli_flush (void)
+{
+}
+
+#endif /* LOCCIONI_CLI_TX_BUFFER_SIZE */
+
+#if (LOCCIONI_CLI_FRAMED == 1) || (LOCCIONI_CLI_TRANSFER == 1) || (LOCCIONI_CLI_PARAMETERS == 1)
+
+static const uint16_t Cli_crcTable[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+};
+
+/**
+ * CRC16-CCITT (polynomial 0x1021), computed four bits at a time to keep
+ * the table small.
+ */
+static uint16_t Cli_crc16 (uint16_t crc, uint8_t data)
+{
+    crc = (crc << 4) ^ Cli_crcTable[(crc >> 12) ^ (data >> 4)];
+    crc = (crc << 4) ^ Cli_crcTable[(crc >> 12) ^ (data & 0x0F)];
+    return crc;
+}
+#endif
+
+#if LOCCIONI_CLI_FRAMED == 1
+
+#define CLI_SLIP_END                 0xC0
+#define CLI_SLIP_ESC                 0xDB
+#define CLI_SLIP_ESC_END             0xDC
+#define CLI_SLIP_ESC_ESC             0xDD
+
+static void Cli_frameWrite (const char* data, uint16_t length)
+{
+    static const char escEnd[2] = {(char)CLI_SLIP_ESC, (char)CLI_SLIP_ESC_END};
+    static const char escEsc[2] = {(char)CLI_SLIP_ESC, (char)CLI_SLIP_ESC_ESC};
+    uint16_t start = 0;
+    uint16_t i;
+
+    for (i = 0; i < length; ++i)
+    {
+        Cli_context->frameCrc = Cli_crc16(Cli_context->frameCrc,(uint8_t)data[i]);
+
+        if (((uint8_t)data[i] == CLI_SLIP_END) || ((uint8_t)data[i] == CLI_SLIP_ESC))
         {
-            if (Utility_isValidIp4Address(argv[2]))
-            {
-                sscanf(argv[2],
-                       "%d.%d.%d.%d",
-                       &tmp[0],
-                       &tmp[1],
-                       &tmp[2],
-                       &tmp[3]);
+            Cli_writeRaw(&data[start],i - start);
+            Cli_writeRaw(((uint8_t)data[i] == CLI_SLIP_END) ? escEnd : escEsc,2);
+            start = i + 1;
+        }
+    }
+    Cli_writeRaw(&data[start],length - start);
+}
 
-                for (uint8_t i = 0; i < 4; ++i) Cli_gatewayAddress[i] = tmp[i];
+static void Cli_frameOpen (uint8_t sequence, uint8_t id)
+{
+    static const char end = (char)CLI_SLIP_END;
 
-                LOCCIONI_CLI_DONECMD();
-                return;
+    /* A leading END flushes any line noise on the receiver side. */
+    Cli_writeRaw(&end,1);
+    Cli_context->frameCrc = 0xFFFF;
+    Cli_context->frameReplyOpen = TRUE;
+    Cli_frameWrite((const char*)&sequence,1);
+    Cli_frameWrite((const char*)&id,1);
+}
+
+static void Cli_frameClose (uint8_t status)
+{
+    static const char end = (char)CLI_SLIP_END;
+    char crc[2];
+
+    Cli_frameWrite((const char*)&status,1);
+    crc[0] = Cli_context->frameCrc & 0xFF;
+    crc[1] = Cli_context->frameCrc >> 8;
+    Cli_frameWrite(crc,2);
+    Cli_writeRaw(&end,1);
+    Cli_context->frameReplyOpen = FALSE;
+}
+
+#endif /* LOCCIONI_CLI_FRAMED */
+
+#if LOCCIONI_CLI_WATCH_LINES > 0
+/**
+ * Filter the output of the command run by watch.
+ *
+ * @return TRUE when the data must not be sent
+ */
+static bool Cli_watchFilter (const char* data, uint16_t length)
+{
+    uint16_t i;
+
+    if (Cli_context->watchHashing)
+    {
+        /* FNV-1a */
+        for (i = 0; i < length; ++i)
+            Cli_context->watchHash = (Cli_context->watchHash ^ (uint8_t)data[i]) * 16777619u;
+        return TRUE;
+    }
+
+    if (Cli_context->watchState == CLI_WATCH_REDRAW)
+        return !Cli_context->watchWrite;
+
+    for (i = 0; i < length; ++i)
+    {
+        if (data[i] == '\n')
+            Cli_context->watchRow++;
+    }
+    return FALSE;
+}
+#endif
+
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+/**
+ * @return TRUE when the helpers write records, not in framed or transfer
+ *         mode that have their own output
+ */
+static bool Cli_isStructured (void)
+{
+#if LOCCIONI_CLI_FRAMED == 1
+    if (Cli_context->framedMode)
+        return FALSE;
+#endif
+#if LOCCIONI_CLI_TRANSFER == 1
+    if (Cli_context->transferMode)
+        return FALSE;
+#endif
+    return Cli_context->outputFormat != CLI_OUTPUT_TEXT;
+}
+
+/**
+ * Write text into a quoted value, with JSON escapes or CSV doubled quotes.
+ * CR is dropped and LF held back, so no value ends with a line end.
+ */
+static void Cli_recordEscape (const char* data, uint16_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+    bool json = (Cli_context->outputFormat == CLI_OUTPUT_JSON);
+    char out[CLI_PRINTF_CHUNK_SIZE + 8];
+    uint8_t count = 0;
+    uint16_t i;
+    char c;
+
+    for (i = 0; i < length; ++i)
+    {
+        c = data[i];
+        if (c == '\r')
+            continue;
+        if (c == '\n')
+        {
+            Cli_context->recordNewline = TRUE;
+            continue;
+        }
+
+        if (Cli_context->recordNewline)
+        {
+            Cli_context->recordNewline = FALSE;
+            if (json)
+            {
+                out[count++] = '\\';
+                out[count++] = 'n';
             }
             else
             {
-                LOCCIONI_CLI_WRONGPARAM();
-                return;
+                out[count++] = ' ';
             }
         }
 
-        if (strcmp(argv[1], "mask") == 0)
+        if ((uint8_t)c < 0x20)
         {
-            if (Utility_isValidIp4Address(argv[2]))
+            if (json)
+            {
+                memcpy(&out[count],"\\u00",4);
+                out[count + 4] = hex[(uint8_t)c >> 4];
+                out[count + 5] = hex[c & 0x0F];
+                count += 6;
+            }
+            else
             {
-                sscanf(argv[2],
-                       "%d.%d.%d.%d",
-                       &tmp[0],
-                       &tmp[1],
-                       &tmp[2],
-                       &tmp[3]);
+                out[count++] = ' ';
+            }
+        }
+        else
+        {
+            if (c == '"')
+                out[count++] = json ? '\\' : '"';
+            else if ((c == '\\') && json)
+                out[count++] = '\\';
+            out[count++] = c;
+        }
+
+        if (count > CLI_PRINTF_CHUNK_SIZE)
+        {
+            Cli_writeRaw(out,count);
+            count = 0;
+        }
+    }
+    if (count > 0)
+        Cli_writeRaw(out,count);
+}
+
+static void Cli_recordFieldEnd (void)
+{
+    if (!Cli_context->fieldOpen)
+        return;
+
+    Cli_context->fieldOpen = FALSE;
+    Cli_context->recordNewline = FALSE;
+    if (Cli_context->outputFormat == CLI_OUTPUT_JSON)
+        Cli_writeRaw("\"",1);
+    else
+        Cli_writeRaw("\"\r\n",3);
+}
+
+/**
+ * Start a field of the record of the line: the value follows.
+ */
+static void Cli_recordField (const char* name)
+{
+    Cli_recordFieldEnd();
+
+    if (Cli_context->outputFormat == CLI_OUTPUT_JSON)
+    {
+        Cli_writeRaw(Cli_context->recordOpen ? ",\"" : "{\"",2);
+        Cli_context->recordOpen = TRUE;
+        Cli_recordEscape(name,strlen(name));
+        Cli_writeRaw("\":\"",3);
+    }
+    else
+    {
+        Cli_writeRaw("\"",1);
+        Cli_recordEscape(name,strlen(name));
+        Cli_writeRaw("\",\"",3);
+    }
+    Cli_context->fieldOpen = TRUE;
+}
+
+/**
+ * Send the JSON object of the line as it is, for example before a message.
+ */
+static void Cli_recordClose (void)
+{
+    Cli_recordFieldEnd();
+    if (Cli_context->recordOpen)
+    {
+        Cli_writeRaw("}\r\n",3);
+        Cli_context->recordOpen = FALSE;
+        Cli_context->recordSent = TRUE;
+    }
+}
+
+/**
+ * The running line is over: complete its record, or send an empty one.
+ */
+static void Cli_recordEnd (void)
+{
+    if (Cli_context->recordPending && Cli_isStructured())
+    {
+        if (Cli_context->outputFormat == CLI_OUTPUT_JSON)
+        {
+            if (!Cli_context->recordOpen && !Cli_context->recordSent)
+                Cli_writeRaw("{}\r\n",4);
+            Cli_recordClose();
+        }
+        else
+        {
+            Cli_recordFieldEnd();
+            Cli_writeRaw("\r\n",2);
+        }
+    }
+    Cli_context->recordPending = FALSE;
+    Cli_context->recordSent = FALSE;
+}
+
+/**
+ * Text written by the line outside of the helpers goes into its "text"
+ * field. Prompt, echo and redraws, written while no line runs, are dropped.
+ */
+static void Cli_recordText (const char* data, uint16_t length)
+{
+    if (!Cli_context->fieldOpen)
+    {
+        while ((length > 0) && ((*data == '\r') || (*data == '\n')))
+        {
+            data++;
+            length--;
+        }
+        if ((length == 0) || !Cli_context->recordPending)
+            return;
+        Cli_recordField("text");
+    }
+    Cli_recordEscape(data,length);
+}
+
+/**
+ * A message is a record of its own, also while a line is running.
+ */
+static void Cli_recordMessage (Cli_MessageType type, const char* who, const char* message)
+{
+    static const char* const types[] = {"info", "warning", "error"};
+
+    if (Cli_context->outputFormat == CLI_OUTPUT_JSON)
+    {
+        Cli_recordClose();
+        Cli_recordField("type");
+        Cli_recordEscape(types[type],strlen(types[type]));
+        Cli_recordField("from");
+        Cli_recordEscape(who,strlen(who));
+        Cli_recordField("message");
+        Cli_recordEscape(message,strlen(message));
+        Cli_recordFieldEnd();
+        Cli_writeRaw("}\r\n",3);
+        Cli_context->recordOpen = FALSE;
+        return;
+    }
+
+    Cli_recordFieldEnd();
+    Cli_writeRaw("\"",1);
+    Cli_recordEscape(types[type],strlen(types[type]));
+    Cli_writeRaw("\",\"",3);
+    Cli_recordEscape(who,strlen(who));
+    Cli_writeRaw("\",\"",3);
+    Cli_recordEscape(message,strlen(message));
+    Cli_context->recordNewline = FALSE;
+    Cli_writeRaw("\"\r\n",3);
+}
+#endif /* LOCCIONI_CLI_OUTPUT_FORMAT */
+
+static void Cli_write (const char* data, uint16_t length)
+{
+#if LOCCIONI_CLI_WATCH_LINES > 0
+    if ((Cli_context->watchState != CLI_WATCH_OFF) && Cli_watchFilter(data,length))
+        return;
+#endif
+#if LOCCIONI_CLI_STATISTICS == 1
+    Cli_outputBytes += length;
+#endif
+#if LOCCIONI_CLI_FRAMED == 1
+    if (Cli_context->frameReplyOpen)
+    {
+        Cli_frameWrite(data,length);
+        return;
+    }
+    /* Text written outside a reply would break the framing. */
+    if (Cli_context->framedMode)
+        return;
+#endif
+#if LOCCIONI_CLI_TRANSFER == 1
+    if (Cli_context->transferMode)
+        return;
+#endif
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    if (Cli_context->outputFormat != CLI_OUTPUT_TEXT)
+    {
+        Cli_recordText(data,length);
+        return;
+    }
+#endif
+    Cli_writeRaw(data,length);
+}
+
+static void Cli_putChar (char c)
+{
+    Cli_write(&c,1);
+}
+
+static void Cli_puts (const char* text)
+{
+    Cli_write(text,strlen(text));
+}
+
+static void Cli_putsln (const char* text)
+{
+    Cli_write(text,strlen(text));
+    Cli_write("\r\n",2);
+}
+
+/**
+ * Send count times the same char, in blocks instead of char by char.
+ */
+static void Cli_putFill (char c, uint8_t count)
+{
+    char fill[16];
+    uint8_t length;
+
+    memset(fill,c,sizeof(fill));
+    while (count > 0)
+    {
+        length = (count < sizeof(fill)) ? count : sizeof(fill);
+        Cli_write(fill,length);
+        count -= length;
+    }
+}
+
+/**
+ * Send the text followed by blanks up to width chars.
+ */
+static void Cli_putPadded (const char* text, uint8_t width)
+{
+    uint8_t length = strlen(text);
+
+    Cli_write(text,length);
+    if (length < width)
+        Cli_putFill(' ',width - length);
+}
+
+/*
+ * Formatter used by Cli_printf: the output is collected on the stack in
+ * chunks of CLI_PRINTF_CHUNK_SIZE bytes and written out, so there is no
+ * line length limit and nothing is shared between calls.
+ */
+
+typedef struct _Cli_Formatter
+{
+    char buffer[CLI_PRINTF_CHUNK_SIZE];
+    uint8_t length;
+} Cli_Formatter;
+
+static void Cli_formatPut (Cli_Formatter* formatter, char c)
+{
+    formatter->buffer[formatter->length++] = c;
+    if (formatter->length == CLI_PRINTF_CHUNK_SIZE)
+    {
+        Cli_write(formatter->buffer,CLI_PRINTF_CHUNK_SIZE);
+        formatter->length = 0;
+    }
+}
+
+/**
+ * Put text, padded with the fill char up to width: on the right when
+ * left is TRUE, otherwise on the left.
+ */
+static void Cli_formatText (Cli_Formatter* formatter,
+                            const char* text,
+                            uint8_t length,
+                            uint8_t width,
+                            bool left,
+                            char fill)
+{
+    uint8_t blank = (length < width) ? (width - length) : 0;
+
+    /* The sign comes before the leading zeros. */
+    if ((fill == '0') && (length > 0) && (*text == '-'))
+    {
+        Cli_formatPut(formatter,*text++);
+        length--;
+    }
+
+    if (!left)
+        while (blank-- > 0) Cli_formatPut(formatter,fill);
+    while (length-- > 0)
+        Cli_formatPut(formatter,*text++);
+    if (left)
+        while (blank-- > 0) Cli_formatPut(formatter,' ');
+}
+
+/**
+ * Convert a number into text, right aligned into the buffer.
+ *
+ * @param decimals Digits after the decimal point, for fixed point values
+ * @return The first char of the number
+ */
+static char* Cli_formatNumber (char* end,
+                               unsigned long value,
+                               bool negative,
+                               uint8_t base,
+                               bool upper,
+                               uint8_t decimals)
+{
+    const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char* text = end;
+    uint8_t count = 0;
+
+    do
+    {
+        *--text = digits[value % base];
+        value /= base;
+        if (++count == decimals)
+            *--text = '.';
+    }
+    while ((value > 0) || (count <= decimals));
+
+    if (*text == '.')
+        *--text = '0';
+    if (negative)
+        *--text = '-';
+    return text;
+}
+
+static void Cli_vprintf (const char* format, va_list args)
+{
+    Cli_Formatter formatter;
+    /* 64 bit value in decimal, sign and decimal point */
+    char number[24];
+    char* text;
+    const uint8_t* address;
+    long value;
+    uint8_t width;
+    uint8_t decimals;
+    uint8_t length;
+    uint8_t i;
+    bool left;
+    bool isLong;
+    char fill;
+
+    formatter.length = 0;
+
+    for (; *format != '\0'; format++)
+    {
+        if (*format != '%')
+        {
+            Cli_formatPut(&formatter,*format);
+            continue;
+        }
+        format++;
+
+        left = FALSE;
+        fill = ' ';
+        for (;; format++)
+        {
+            if (*format == '-') left = TRUE;
+            else if (*format == '0') fill = '0';
+            else break;
+        }
+
+        width = 0;
+        if (*format == '*')
+        {
+            width = va_arg(args,int);
+            format++;
+        }
+        while ((*format >= '0') && (*format <= '9'))
+            width = width * 10 + (*format++ - '0');
+
+        decimals = 0;
+        if (*format == '.')
+        {
+            format++;
+            while ((*format >= '0') && (*format <= '9'))
+                decimals = decimals * 10 + (*format++ - '0');
+        }
+
+        isLong = (*format == 'l');
+        if (isLong) format++;
+
+        switch (*format)
+        {
+        case 'd':
+        case 'i':
+        case 'q':
+            value = isLong ? va_arg(args,long) : va_arg(args,int);
+            text = Cli_formatNumber(&number[sizeof(number)],
+                                    (value < 0) ? -(unsigned long)value : (unsigned long)value,
+                                    value < 0,
+                                    10,
+                                    FALSE,
+                                    (*format == 'q') ? decimals : 0);
+            break;
+
+        case 'u':
+        case 'x':
+        case 'X':
+            value = isLong ? va_arg(args,unsigned long) : va_arg(args,unsigned int);
+            text = Cli_formatNumber(&number[sizeof(number)],
+                                    (unsigned long)value,
+                                    FALSE,
+                                    (*format == 'u') ? 10 : 16,
+                                    *format == 'X',
+                                    0);
+            break;
+
+        case 'c':
+            number[0] = (char)va_arg(args,int);
+            Cli_formatText(&formatter,number,1,width,left,' ');
+            continue;
+
+        case 's':
+            text = va_arg(args,char*);
+            length = strlen(text);
+            Cli_formatText(&formatter,text,length,width,left,' ');
+            continue;
+
+        case 'I':
+        case 'M':
+            /* IPv4 as x.x.x.x or MAC as XX:XX:XX:XX:XX:XX */
+            address = va_arg(args,const uint8_t*);
+            text = &number[sizeof(number)];
+            for (i = (*format == 'I') ? 4 : 6; i > 0; --i)
+            {
+                text = Cli_formatNumber(text,
+                                        address[i-1],
+                                        FALSE,
+                                        (*format == 'I') ? 10 : 16,
+                                        TRUE,
+                                        0);
+                if ((*format == 'M') && (address[i-1] < 0x10))
+                    *--text = '0';
+                if (i > 1)
+                    *--text = (*format == 'I') ? '.' : ':';
+            }
+            break;
+
+        case '%':
+            Cli_formatPut(&formatter,'%');
+            continue;
+
+        default:
+            /* Unknown conversion: print it as is. */
+            if (*format == '\0')
+                format--;
+            else
+                Cli_formatPut(&formatter,*format);
+            continue;
+        }
+
+        length = &number[sizeof(number)] - text;
+        Cli_formatText(&formatter,text,length,width,left,left ? ' ' : fill);
+    }
+
+    if (formatter.length > 0)
+        Cli_write(formatter.buffer,formatter.length);
+}
+
+void Cli_printf (const char* format, ...)
+{
+    va_list args;
+
+    va_start(args,format);
+    Cli_vprintf(format,args);
+    va_end(args);
+}
+
+/**
+ * Compare the token of given length with a null terminated command name,
+ * with the same sign convention of strcmp.
+ */
+static int Cli_compareName (const char* token, uint8_t length, const char* name)
+{
+    int result = strncmp(token,name,length);
+
+    if (result != 0)
+        return result;
+    /* Same prefix: the token is smaller when the name goes on. */
+    return (name[length] == '\0') ? 0 : -1;
+}
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+
+static const Cli_Command* Cli_getStaticCommand (const char* name, uint8_t length)
+{
+    uint8_t low = 0;
+    uint8_t high = CLI_STATIC_COMMAND_TABLE_SIZED;
+    uint8_t middle;
+    int result;
+
+    if (!Cli_staticCommandSorted)
+    {
+        for (low = 0; low < high; low++)
+        {
+            if (Cli_compareName(name,length,Cli_staticCommandTable[low].name) == 0)
+                return &Cli_staticCommandTable[low];
+        }
+        return 0;
+    }
+
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        result = Cli_compareName(name,length,Cli_staticCommandTable[middle].name);
+
+        if (result == 0)
+            return &Cli_staticCommandTable[middle];
+        else if (result < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return 0;
+}
+
+/**
+ * The static table can not be sorted by the preprocessor: check once that
+ * it has been written in alphabetical order, otherwise fall back to a
+ * linear search.
+ */
+static void Cli_checkStaticCommand (void)
+{
+    uint8_t i;
+
+    Cli_staticCommandSorted = TRUE;
+    for (i = 1; i < CLI_STATIC_COMMAND_TABLE_SIZED; i++)
+    {
+        if (strcmp(Cli_staticCommandTable[i-1].name,Cli_staticCommandTable[i].name) >= 0)
+        {
+            Cli_staticCommandSorted = FALSE;
+            Cli_sendMessage("cli","LOCCIONI_CLI_STATIC_COMMANDS is not sorted",CLI_MESSAGETYPE_WARNING);
+            return;
+        }
+    }
+}
+
+#endif /* LOCCIONI_CLI_STATIC_COMMANDS */
+
+#if CLI_DYNAMIC_COMMANDS == 1
+
+/**
+ * Insert a command into the sorted index.
+ *
+ * @return FALSE when a command with the same name is already present
+ */
+static bool Cli_indexInsert (const Cli_Command* cmd)
+{
+    uint8_t length = strlen(cmd->name);
+    uint8_t low = 0;
+    uint8_t high = Cli_commandIndexSize;
+    uint8_t middle;
+    int result;
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+    if (Cli_getStaticCommand(cmd->name,length) != 0)
+        return FALSE;
+#endif
+
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        result = Cli_compareName(cmd->name,length,Cli_commandIndex[middle]->name);
+
+        if (result == 0)
+            return FALSE;
+        else if (result < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+
+    memmove(&Cli_commandIndex[low + 1],
+            &Cli_commandIndex[low],
+            (Cli_commandIndexSize - low) * sizeof(Cli_commandIndex[0]));
+    Cli_commandIndex[low] = cmd;
+    Cli_commandIndexSize++;
+    return TRUE;
+}
+
+/**
+ * The internal commands are indexed the first time a command is added or
+ * searched, so Cli_addCommand can be called before Cli_init.
+ */
+static void Cli_indexInit (void)
+{
+    uint8_t i;
+
+    if (Cli_commandIndexSize != 0)
+        return;
+
+    for (i = 0; i < CLI_COMMAND_TABLE_SIZED; i++)
+        Cli_indexInsert(&Cli_commandTable[i]);
+}
+
+#endif /* CLI_DYNAMIC_COMMANDS */
+
+/**
+ * Search a command: internal and runtime commands are searched with a
+ * binary search into the sorted index, then the static table. Only the
+ * whole token matches, so "helpme" does not run "help".
+ *
+ * @param name The first parameter of the line
+ * @return The command, or null when not found
+ */
+static const Cli_Command* Cli_getCommand (const char* name)
+{
+    uint8_t length = 0;
+    uint8_t low = 0;
+    uint8_t high;
+    uint8_t middle;
+    int result;
+
+    while (name[length] != '\0')
+        length++;
+
+#if CLI_DYNAMIC_COMMANDS == 1
+    Cli_indexInit();
+    high = Cli_commandIndexSize;
+
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        result = Cli_compareName(name,length,Cli_commandIndex[middle]->name);
+
+        if (result == 0)
+            return Cli_commandIndex[middle];
+        else if (result < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+#else
+    (void)middle;
+    (void)result;
+    for (high = CLI_COMMAND_TABLE_SIZED; low < high; low++)
+    {
+        if (Cli_compareName(name,length,Cli_commandTable[low].name) == 0)
+            return &Cli_commandTable[low];
+    }
+#endif
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+    return Cli_getStaticCommand(name,length);
+#else
+    /* If we don't find any command, return null. */
+    return 0;
+#endif
+}
+
+/*
+ * Streaming line parser: every received byte is tokenized at once, and the
+ * command is searched as soon as its name ends, so at CR LF the line is
+ * ready to run. The work per byte is constant, except:
+ *  - the end of a command name: one Cli_getCommand, a binary search;
+ *  - backspace: the line is parsed again, at most LOCCIONI_CLI_LINE_SIZE
+ *    bytes.
+ */
+
+static void Cli_lineReset (void)
+{
+    Cli_context->tokensIndex = 0;
+    Cli_context->numberOfParams = 0;
+    Cli_context->numberOfCommands = 0;
+    Cli_context->isStringOpen = FALSE;
+    Cli_context->isParamOpen = FALSE;
+    Cli_context->lineOverflow = FALSE;
+
+    Cli_context->lineCommands[0].cmd = 0;
+    Cli_context->lineCommands[0].firstParam = 0;
+    Cli_context->lineCommands[0].numberOfParams = 0;
+    Cli_context->lineCommands[0].wrongParam = FALSE;
+}
+
+static void Cli_lineParamEnd (void)
+{
+    Cli_LineCommand* command = &Cli_context->lineCommands[Cli_context->numberOfCommands];
+
+    Cli_context->isParamOpen = FALSE;
+    if (command->wrongParam)
+        return;
+
+    Cli_context->tokens[Cli_context->tokensIndex++] = '\0';
+    if (command->numberOfParams == 1)
+        command->cmd = Cli_getCommand(Cli_context->params[command->firstParam]);
+}
+
+static void Cli_lineCommandEnd (void)
+{
+    Cli_LineCommand* command;
+
+    if (Cli_context->isParamOpen)
+        Cli_lineParamEnd();
+
+    /* Only blanks: the slot is used by the next command. */
+    if (Cli_context->lineCommands[Cli_context->numberOfCommands].numberOfParams == 0)
+        return;
+
+    if (++Cli_context->numberOfCommands == CLI_MAX_LINE_COMMAND)
+    {
+        Cli_context->lineOverflow = TRUE;
+        return;
+    }
+
+    command = &Cli_context->lineCommands[Cli_context->numberOfCommands];
+    command->cmd = 0;
+    command->firstParam = Cli_context->numberOfParams;
+    command->numberOfParams = 0;
+    command->wrongParam = FALSE;
+}
+
+static void Cli_lineParamChar (char c)
+{
+    Cli_LineCommand* command = &Cli_context->lineCommands[Cli_context->numberOfCommands];
+
+    if (!Cli_context->isParamOpen)
+    {
+        Cli_context->isParamOpen = TRUE;
+
+        if (command->numberOfParams == CLI_MAX_PARAM)
+            command->wrongParam = TRUE;
+        if (command->wrongParam)
+            return;
+
+        if (Cli_context->numberOfParams == CLI_MAX_LINE_PARAM)
+        {
+            Cli_context->lineOverflow = TRUE;
+            return;
+        }
+        Cli_context->params[Cli_context->numberOfParams++] = &Cli_context->tokens[Cli_context->tokensIndex];
+        command->numberOfParams++;
+    }
+
+    /* The quote itself is not copied. */
+    if (command->wrongParam || (c == '\"'))
+        return;
+
+    /* Keep one byte for the terminator. */
+    if (Cli_context->tokensIndex >= (LOCCIONI_CLI_LINE_SIZE - 1))
+    {
+        Cli_context->lineOverflow = TRUE;
+        return;
+    }
+    Cli_context->tokens[Cli_context->tokensIndex++] = c;
+}
+
+static void Cli_lineFeed (char c)
+{
+    if (Cli_context->lineOverflow)
+        return;
+
+    if ((c == '\r') || (c == '\n'))
+    {
+        return;
+    }
+    else if (c == '\"')
+    {
+        Cli_context->isStringOpen = !Cli_context->isStringOpen;
+        Cli_lineParamChar(c);
+    }
+    else if ((c == ' ') && !Cli_context->isStringOpen)
+    {
+        if (Cli_context->isParamOpen)
+            Cli_lineParamEnd();
+    }
+    else if ((c == ';') && !Cli_context->isStringOpen)
+    {
+        Cli_lineCommandEnd();
+    }
+    else
+    {
+        Cli_lineParamChar(c);
+    }
+}
+
+/**
+ * Parse again the received line, after a backspace.
+ */
+static void Cli_lineRefeed (void)
+{
+    uint8_t i;
+
+    Cli_lineReset();
+    for (i = 0; i < Cli_context->bufferIndex; ++i)
+        Cli_lineFeed(Cli_context->buffer[i]);
+}
+
+/**
+ * Prompt of the current line, without the leading CR LF.
+ */
+static const char* Cli_promptText (void)
+{
+#if LOCCIONI_CLI_BATCH_SIZE > 0
+    if (Cli_context->batchOpen)
+        return "batch> ";
+#endif
+    return "$> ";
+}
+
+static void Cli_prompt (void)
+{
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    Cli_recordEnd();
+    /* Programs find the end of the line in its record. */
+    if (!Cli_isStructured())
+#endif
+    Cli_printf("\r\n%s",Cli_promptText());
+    Cli_context->bufferIndex = 0;
+#if LOCCIONI_CLI_EDITOR == 1
+    Cli_context->cursor = 0;
+#endif
+    Cli_lineReset();
+}
+
+static void Cli_sayHello (void)
+{
+    Cli_puts("\r\n");
+    Cli_putFill('*',CLI_MAX_CHARS_PER_LINE);
+    Cli_puts("\r\n");
+    Cli_putsln(PROJECT_NAME);
+    Cli_putsln(PROJECT_COPYRIGTH);
+    Cli_putFill('*',CLI_MAX_CHARS_PER_LINE);
+    Cli_puts("\r\n");
+    Cli_functionVersion(0,0,0);
+    Cli_putFill('*',CLI_MAX_CHARS_PER_LINE);
+    Cli_puts("\r\n");
+}
+
+#if (LOCCIONI_CLI_TYPED_ARGUMENTS == 1) || (LOCCIONI_CLI_ETHERNET == 1)
+
+/**
+ * @return The value of a decimal or hexadecimal digit, 0xFF otherwise
+ */
+static uint8_t Cli_digitValue (char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+    return 0xFF;
+}
+
+/**
+ * Parse count bytes written in base and divided by separator, such as an
+ * IPv4 (10, '.') or a MAC address (16, ':').
+ */
+static bool Cli_parseBytes (const char* text, uint8_t count, char separator, uint8_t base, uint8_t* bytes)
+{
+    uint8_t maxDigits = (base == 16) ? 2 : 3;
+    uint8_t digits;
+    uint8_t digit;
+    uint16_t value;
+    uint8_t i;
+
+    for (i = 0; i < count; ++i)
+    {
+        value = 0;
+        digits = 0;
+        while ((digit = Cli_digitValue(*text)) < base)
+        {
+            value = value * base + digit;
+            if ((++digits > maxDigits) || (value > 255))
+                return FALSE;
+            text++;
+        }
+        if (digits == 0)
+            return FALSE;
+        if (*text != ((i == count - 1) ? '\0' : separator))
+            return FALSE;
+
+        bytes[i] = value;
+        text++;
+    }
+    return TRUE;
+}
+
+#endif
+
+#if LOCCIONI_CLI_TYPED_ARGUMENTS == 1
+
+/**
+ * Parse a signed decimal, or a hexadecimal with the 0x prefix. In base 16
+ * the prefix is optional and all the 32 bits can be used.
+ */
+static bool Cli_parseInteger (const char* text, uint8_t base, int32_t* value)
+{
+    bool negative = FALSE;
+    uint32_t result = 0;
+    uint32_t limit;
+    uint8_t digit;
+
+    if ((base == 10) && ((*text == '-') || (*text == '+')))
+        negative = (*text++ == '-');
+
+    /* INT is signed also when written 0x..., HEX takes all the 32 bits. */
+    if (base == 16)
+        limit = 0xFFFFFFFFu;
+    else
+        limit = negative ? 0x80000000u : 0x7FFFFFFFu;
+
+    if ((text[0] == '0') && ((text[1] == 'x') || (text[1] == 'X')))
+    {
+        base = 16;
+        text += 2;
+    }
+    if (*text == '\0')
+        return FALSE;
+
+    for (; *text != '\0'; ++text)
+    {
+        digit = Cli_digitValue(*text);
+        if ((digit >= base) || (result > (limit - digit) / base))
+            return FALSE;
+        result = result * base + digit;
+    }
+
+    *value = negative ? (int32_t)(0u - result) : (int32_t)result;
+    return TRUE;
+}
+
+static bool Cli_parseFloat (const char* text, float* value)
+{
+    bool negative = FALSE;
+    bool digits = FALSE;
+    float result = 0.0f;
+    float scale = 1.0f;
+
+    if ((*text == '-') || (*text == '+'))
+        negative = (*text++ == '-');
+
+    for (; (*text >= '0') && (*text <= '9'); ++text, digits = TRUE)
+        result = result * 10.0f + (*text - '0');
+    if (*text == '.')
+    {
+        for (++text; (*text >= '0') && (*text <= '9'); ++text, digits = TRUE)
+        {
+            scale /= 10.0f;
+            result += (*text - '0') * scale;
+        }
+    }
+    if (!digits || (*text != '\0'))
+        return FALSE;
+
+    *value = negative ? -result : result;
+    return TRUE;
+}
+
+static bool Cli_parseArgument (const Cli_Argument* argument, const char* text, Cli_Value* value)
+{
+    bool ranged = argument->min < argument->max;
+    uint8_t i;
+
+    switch (argument->type)
+    {
+    case CLI_ARGTYPE_INT:
+        return Cli_parseInteger(text,10,&value->integer) &&
+               (!ranged || ((value->integer >= argument->min) && (value->integer <= argument->max)));
+
+    case CLI_ARGTYPE_HEX:
+        return Cli_parseInteger(text,16,&value->integer) &&
+               (!ranged || (((uint32_t)value->integer >= (uint32_t)argument->min) &&
+                            ((uint32_t)value->integer <= (uint32_t)argument->max)));
+
+    case CLI_ARGTYPE_FLOAT:
+        return Cli_parseFloat(text,&value->real) &&
+               (!ranged || ((value->real >= argument->min) && (value->real <= argument->max)));
+
+    case CLI_ARGTYPE_IPV4:
+        return Cli_parseBytes(text,4,'.',10,value->ip);
+
+    case CLI_ARGTYPE_MAC:
+        return Cli_parseBytes(text,6,':',16,value->mac);
+
+    case CLI_ARGTYPE_KEYWORD:
+        for (i = 0; argument->keywords[i] != 0; ++i)
+        {
+            if (strcmp(text,argument->keywords[i]) == 0)
+            {
+                value->integer = i;
+                return TRUE;
+            }
+        }
+        return FALSE;
+
+    case CLI_ARGTYPE_STRING:
+        value->string = text;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Print what an argument accepts, as in "int 0..255".
+ */
+static void Cli_putArgumentType (const Cli_Argument* argument)
+{
+    static const char* const names[] =
+    {
+        "int", "hex", "float", "ip x.x.x.x", "mac yy:yy:yy:yy:yy:yy", "one of", "string",
+    };
+    uint8_t i;
+
+    Cli_puts(names[argument->type]);
+
+    if (argument->type == CLI_ARGTYPE_KEYWORD)
+    {
+        for (i = 0; argument->keywords[i] != 0; ++i)
+        {
+            Cli_putChar((i == 0) ? ' ' : '|');
+            Cli_puts(argument->keywords[i]);
+        }
+    }
+    else if (argument->min < argument->max)
+    {
+        if (argument->type == CLI_ARGTYPE_HEX)
+            Cli_printf(" 0x%lX..0x%lX",(unsigned long)(uint32_t)argument->min,(unsigned long)(uint32_t)argument->max);
+        else if (argument->type != CLI_ARGTYPE_STRING)
+            Cli_printf(" %ld..%ld",(long)argument->min,(long)argument->max);
+    }
+}
+
+static void Cli_putUsage (const Cli_Command* cmd)
+{
+    const Cli_Argument* argument;
+    bool optional = FALSE;
+    uint8_t i;
+
+    Cli_puts("Usage: ");
+    Cli_puts(cmd->name);
+    for (i = 0; i < cmd->numberOfArguments; ++i)
+    {
+        argument = &cmd->arguments[i];
+        optional = optional || argument->optional;
+        Cli_puts(optional ? " [" : " <");
+        Cli_puts(argument->name);
+        Cli_putChar(optional ? ']' : '>');
+    }
+    Cli_puts("\r\n");
+}
+
+/**
+ * Help of a typed command: one line for every argument.
+ */
+static void Cli_putArguments (const Cli_Command* cmd)
+{
+    uint8_t i;
+
+    for (i = 0; i < cmd->numberOfArguments; ++i)
+    {
+        Cli_puts("  ");
+        Cli_putPadded(cmd->arguments[i].name,CLI_MAX_CMD_CHAR_LINE - 2);
+        Cli_putChar(';');
+        Cli_putArgumentType(&cmd->arguments[i]);
+        Cli_puts("\r\n");
+    }
+}
+
+/**
+ * Validate and convert every argument in one pass, then call the handler.
+ */
+static void Cli_runTypedCommand (const Cli_Command* cmd, int argc, char* argv[])
+{
+    Cli_Value values[CLI_MAX_PARAM];
+    const Cli_Argument* argument;
+    uint8_t required = 0;
+    uint8_t i;
+
+    for (i = 0; (i < cmd->numberOfArguments) && !cmd->arguments[i].optional; ++i)
+        required++;
+
+    if ((argc - 1 < required) || (argc - 1 > cmd->numberOfArguments))
+    {
+        Cli_putUsage(cmd);
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+
+    for (i = 1; i < argc; ++i)
+    {
+        argument = &cmd->arguments[i - 1];
+        if (!Cli_parseArgument(argument,argv[i],&values[i - 1]))
+        {
+            Cli_context->commandError = TRUE;
+            Cli_printf("ERR: %s must be ",argument->name);
+            Cli_putArgumentType(argument);
+            Cli_puts("\r\n");
+            return;
+        }
+    }
+
+    cmd->typedFunction(cmd->device,argc - 1,values);
+}
+
+#endif /* LOCCIONI_CLI_TYPED_ARGUMENTS */
+
+static void Cli_printCommandHelp (const Cli_Command* cmd)
+{
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    if (Cli_isStructured())
+    {
+        Cli_sendHelpString(cmd->name,cmd->description);
+        if (cmd->type == CLI_COMMANDTYPE_MODULE)
+            Cli_runCommand(cmd,1,0);
+        return;
+    }
+#endif
+    Cli_putPadded(cmd->name,CLI_MAX_CMD_CHAR_LINE);
+    Cli_putChar(';');
+    Cli_putsln(cmd->description);
+
+    // Print help menu of the module!
+    if (cmd->type == CLI_COMMANDTYPE_MODULE)
+        Cli_runCommand(cmd,1,0);
+#if LOCCIONI_CLI_TYPED_ARGUMENTS == 1
+    else if (cmd->typedFunction != 0)
+        Cli_putArguments(cmd);
+#endif
+}
+
+/**
+ * Number of commands listed by help, in the order of Cli_getHelpCommand.
+ */
+static uint8_t Cli_getHelpCount (void)
+{
+    uint8_t count = CLI_COMMAND_TABLE_SIZED;
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+    count += CLI_STATIC_COMMAND_TABLE_SIZED;
+#endif
+#if CLI_MAX_EXTERNAL_COMMAND > 0
+    count += Cli_externalCommandIndex;
+#endif
+#if CLI_MAX_EXTERNAL_MODULE > 0
+    count += Cli_externalModuleIndex;
+#endif
+    return count;
+}
+
+/**
+ * The commands listed by help: internal, static and external commands,
+ * then the external modules.
+ */
+static const Cli_Command* Cli_getHelpCommand (uint8_t position)
+{
+    if (position < CLI_COMMAND_TABLE_SIZED)
+        return &Cli_commandTable[position];
+    position -= CLI_COMMAND_TABLE_SIZED;
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+    if (position < CLI_STATIC_COMMAND_TABLE_SIZED)
+        return &Cli_staticCommandTable[position];
+    position -= CLI_STATIC_COMMAND_TABLE_SIZED;
+#endif
+
+#if CLI_MAX_EXTERNAL_COMMAND > 0
+    if (position < Cli_externalCommandIndex)
+        return &Cli_externalCommandTable[position];
+    position -= Cli_externalCommandIndex;
+#endif
+
+#if CLI_MAX_EXTERNAL_MODULE > 0
+    if (position < Cli_externalModuleIndex)
+        return &Cli_externalModuleTable[position];
+#endif
+    return 0;
+}
+
+#if (LOCCIONI_CLI_FRAMED == 1) || (LOCCIONI_CLI_STATISTICS == 1)
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+#define CLI_COMMAND_SLOTS  (CLI_COMMAND_TABLE_SIZED + CLI_STATIC_COMMAND_TABLE_SIZED + \
+                            CLI_MAX_EXTERNAL_COMMAND + CLI_MAX_EXTERNAL_MODULE)
+#else
+#define CLI_COMMAND_SLOTS  (CLI_COMMAND_TABLE_SIZED + \
+                            CLI_MAX_EXTERNAL_COMMAND + CLI_MAX_EXTERNAL_MODULE)
+#endif
+
+/* Identifiers are uint8_t, and framed mode reserves 0xFD-0xFF. */
+#if (CLI_MAX_EXTERNAL_COMMAND + CLI_MAX_EXTERNAL_MODULE) > 0xFD
+#error "CLI_MAX_EXTERNAL_COMMAND + CLI_MAX_EXTERNAL_MODULE exceed the command identifiers"
+#endif
+/* The tables are sized with sizeof, which #if can not see: a negative array size stops the build. */
+typedef char Cli_CommandSlotsCheck[(CLI_COMMAND_SLOTS <= 0xFD) ? 1 : -1];
+
+/**
+ * Command identifiers are stable: internal commands first, then the
+ * static table, then CLI_MAX_EXTERNAL_COMMAND slots for runtime commands
+ * and finally the runtime modules.
+ */
+static const Cli_Command* Cli_getCommandById (uint8_t id)
+{
+    if (id < CLI_COMMAND_TABLE_SIZED)
+        return &Cli_commandTable[id];
+    id -= CLI_COMMAND_TABLE_SIZED;
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+    if (id < CLI_STATIC_COMMAND_TABLE_SIZED)
+        return &Cli_staticCommandTable[id];
+    id -= CLI_STATIC_COMMAND_TABLE_SIZED;
+#endif
+
+#if CLI_MAX_EXTERNAL_COMMAND > 0
+    if (id < CLI_MAX_EXTERNAL_COMMAND)
+        return (id < Cli_externalCommandIndex) ? &Cli_externalCommandTable[id] : 0;
+#endif
+    id -= CLI_MAX_EXTERNAL_COMMAND;
+
+#if CLI_MAX_EXTERNAL_MODULE > 0
+    if (id < Cli_externalModuleIndex)
+        return &Cli_externalModuleTable[id];
+#endif
+    return 0;
+}
+
+static uint8_t Cli_getCommandId (const Cli_Command* cmd)
+{
+    uint8_t offset = CLI_COMMAND_TABLE_SIZED;
+
+    if ((cmd >= Cli_commandTable) && (cmd < &Cli_commandTable[CLI_COMMAND_TABLE_SIZED]))
+        return cmd - Cli_commandTable;
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+    if ((cmd >= Cli_staticCommandTable) &&
+        (cmd < &Cli_staticCommandTable[CLI_STATIC_COMMAND_TABLE_SIZED]))
+        return offset + (cmd - Cli_staticCommandTable);
+    offset += CLI_STATIC_COMMAND_TABLE_SIZED;
+#endif
+
+#if CLI_MAX_EXTERNAL_COMMAND > 0
+    if ((cmd >= Cli_externalCommandTable) &&
+        (cmd < &Cli_externalCommandTable[CLI_MAX_EXTERNAL_COMMAND]))
+        return offset + (cmd - Cli_externalCommandTable);
+#endif
+    offset += CLI_MAX_EXTERNAL_COMMAND;
+
+#if CLI_MAX_EXTERNAL_MODULE > 0
+    offset += cmd - Cli_externalModuleTable;
+#endif
+    return offset;
+}
+
+#endif
+
+#if LOCCIONI_CLI_STATISTICS == 1
+
+typedef struct _Cli_CommandStatistics
+{
+    uint32_t calls;
+    uint32_t minTime;
+    uint32_t maxTime;
+    uint64_t totalTime;
+    uint32_t bytes;
+} Cli_CommandStatistics;
+
+/** Indexed by command identifier, see Cli_getCommandId. */
+static Cli_CommandStatistics Cli_commandStatistics[CLI_COMMAND_SLOTS];
+
+static void Cli_functionStats (void* device, int argc, char* argv[])
+{
+    const Cli_CommandStatistics* statistics;
+    uint8_t i;
+
+    if ((argc == 2) && (strcmp(argv[1],"reset") == 0))
+    {
+        memset(Cli_commandStatistics,0,sizeof(Cli_commandStatistics));
+        LOCCIONI_CLI_DONECMD();
+        return;
+    }
+
+    if (argc != 1)
+    {
+        Cli_sendHelpString("reset","Clear the statistics");
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+
+    Cli_sendStatusString("command","calls, min/mean/max time (" LOCCIONI_CLI_STATISTICS_UNIT "), bytes",0);
+    for (i = 0; i < CLI_COMMAND_SLOTS; ++i)
+    {
+        statistics = &Cli_commandStatistics[i];
+        if (statistics->calls == 0)
+            continue;
+
+        Cli_sendStatusf(Cli_getCommandById(i)->name,
+                        "%lu, %lu/%lu/%lu, %lu",
+                        (unsigned long)statistics->calls,
+                        (unsigned long)statistics->minTime,
+                        (unsigned long)(statistics->totalTime / statistics->calls),
+                        (unsigned long)statistics->maxTime,
+                        (unsigned long)statistics->bytes);
+    }
+}
+
+/**
+ * Account a call of cmd, whose handler started at start with the output
+ * counter at bytes.
+ */
+static void Cli_addStatistics (const Cli_Command* cmd, uint32_t start, uint32_t bytes)
+{
+    uint32_t time = LOCCIONI_CLI_STATISTICS_CLOCK() - start;
+    Cli_CommandStatistics* statistics = &Cli_commandStatistics[Cli_getCommandId(cmd)];
+
+    if ((statistics->calls == 0) || (time < statistics->minTime))
+        statistics->minTime = time;
+    if (time > statistics->maxTime)
+        statistics->maxTime = time;
+    statistics->totalTime += time;
+    statistics->calls++;
+    statistics->bytes += Cli_outputBytes - bytes;
+}
+
+#endif /* LOCCIONI_CLI_STATISTICS */
+
+/**
+ * Run a command handler from a received line or frame, measuring it when
+ * the statistics are enabled.
+ */
+static void Cli_dispatchCommand (const Cli_Command* cmd, int argc, char* argv[])
+{
+#if LOCCIONI_CLI_STATISTICS == 1
+    uint32_t bytes = Cli_outputBytes;
+    uint32_t start = LOCCIONI_CLI_STATISTICS_CLOCK();
+
+    Cli_runCommand(cmd,argc,argv);
+    Cli_addStatistics(cmd,start,bytes);
+#else
+    Cli_runCommand(cmd,argc,argv);
+#endif
+}
+
+#if LOCCIONI_CLI_FRAMED == 1
+/**
+ * Run the binary handler of a frame, measured like Cli_dispatchCommand.
+ *
+ * @return The status of the reply
+ */
+static uint8_t Cli_dispatchFrame (const Cli_Command* cmd, const uint8_t* data, uint16_t length)
+{
+#if LOCCIONI_CLI_STATISTICS == 1
+    uint32_t bytes = Cli_outputBytes;
+    uint32_t start = LOCCIONI_CLI_STATISTICS_CLOCK();
+    uint8_t status = cmd->framedFunction(cmd->device,data,length);
+
+    Cli_addStatistics(cmd,start,bytes);
+    return status;
+#else
+    return cmd->framedFunction(cmd->device,data,length);
+#endif
+}
+#endif
+
+
+/**
+ * Send one command for every Cli_check, so a long help does not hold the
+ * main loop.
+ */
+static Cli_TaskStatus Cli_helpTask (Cli_Task* task)
+{
+    uint8_t position = Cli_context->helpFirst + task->state;
+
+    if (position < Cli_context->helpEnd)
+    {
+        Cli_printCommandHelp(Cli_getHelpCommand(position));
+        task->state++;
+        return CLI_TASKSTATUS_PENDING;
+    }
+
+    if (Cli_context->helpPages > 1)
+    {
+        Cli_printf("Page %u/%u",Cli_context->helpPage,Cli_context->helpPages);
+        if (Cli_context->helpPage < Cli_context->helpPages)
+            Cli_printf(", next with \"help %u\"",Cli_context->helpPage + 1);
+        Cli_puts("\r\n");
+    }
+    return CLI_TASKSTATUS_DONE;
+}
+
+static void Cli_functionHelp (void* device, int argc, char* argv[])
+{
+    const Cli_Command* cmd;
+    uint8_t count = Cli_getHelpCount();
+    uint8_t size = (LOCCIONI_CLI_HELP_PAGE > 0) ? LOCCIONI_CLI_HELP_PAGE : count;
+    unsigned long page = 1;
+    char* end;
+
+    if (argc > 2)
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+
+    Cli_context->helpPages = (count + size - 1) / size;
+
+    if (argc == 2)
+    {
+        page = strtoul(argv[1],&end,10);
+
+        /* Not a page number: the help of a single command or module. */
+        if ((*end != '\0') || (end == argv[1]))
+        {
+            cmd = Cli_getCommand(argv[1]);
+            if (cmd == 0)
+                Cli_sendError(Cli_notFoundCmd);
+            else
+                Cli_printCommandHelp(cmd);
+            return;
+        }
+
+        /* Checked before the store, that would wrap it into 8 bits. */
+        if ((page == 0) || (page > Cli_context->helpPages))
+        {
+            LOCCIONI_CLI_WRONGPARAM();
+            return;
+        }
+    }
+    Cli_context->helpPage = page;
+
+    Cli_context->helpFirst = (Cli_context->helpPage - 1) * size;
+    Cli_context->helpEnd = ((Cli_context->helpFirst + size) < count) ? (Cli_context->helpFirst + size) : count;
+    Cli_startTask(Cli_helpTask,0,0);
+}
+
+static void Cli_functionVersion (void* device, int argc, char* argv[])
+{
+    char dateString[26];
+
+    Time_unixtimeToString(FW_TIME_VERSION,dateString);
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    if (Cli_isStructured())
+    {
+        Cli_sendStatusString(CLI_BOARD_STRING,PCB_VERSION_STRING,0);
+        Cli_sendStatusf(CLI_FIRMWARE_STRING,"%s of %s",FW_VERSION_STRING,dateString);
+        return;
+    }
+#endif
+
+    /* Board version */
+    Cli_putPadded(CLI_BOARD_STRING,CLI_MAX_STATUS_CHAR_LINE);
+    Cli_puts(": ");
+    Cli_putsln(PCB_VERSION_STRING);
+
+    /* Firmware version */
+    Cli_putPadded(CLI_FIRMWARE_STRING,CLI_MAX_STATUS_CHAR_LINE);
+    Cli_puts(": ");
+    Cli_puts(FW_VERSION_STRING);
+    Cli_puts(" of ");
+    Cli_putsln(dateString);
+}
+
+static void Cli_functionStatus (void* device, int argc, char* argv[])
+{
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    /* Only the fields: the snapshot is a single record. */
+    if (Cli_isStructured())
+    {
+        Cli_functionVersion(0,0,0);
+        return;
+    }
+#endif
+    Cli_putFill('*',CLI_MAX_CHARS_PER_LINE);
+    Cli_puts("\r\n");
+    Cli_putsln("System Status");
+    Cli_putFill('*',CLI_MAX_CHARS_PER_LINE);
+    Cli_puts("\r\n");
+
+    Cli_functionVersion(0,0,0);
+}
+
+#if LOCCIONI_CLI_PARAMETERS == 1
+
+#define CLI_PARAMETER_NAME_SIZE      24
+#define CLI_PARAMETER_MAGIC          0x4D524150u /* "PARM" */
+/* Magic and sequence number, at the start of the bank. */
+#define CLI_PARAMETER_HEADER_SIZE    8
+/* Name and value lengths, name, value and CRC16, padded to the storage unit. */
+#define CLI_PARAMETER_RECORD_SIZE    ((4 + CLI_PARAMETER_NAME_SIZE + LOCCIONI_CLI_PARAMETER_SIZE + \
+                                       LOCCIONI_CLI_STORAGE_ALIGN - 1) & ~(LOCCIONI_CLI_STORAGE_ALIGN - 1))
+
+typedef struct _Cli_Parameter
+{
+    const Cli_Argument* argument;
+    void* value;
+    uint8_t size;
+    /** Changed since the last save. */
+    bool dirty;
+} Cli_Parameter;
+
+typedef struct _Cli_StoreStatistics
+{
+    uint32_t saves;
+    uint32_t records;
+    uint32_t payload;     /**< Bytes of the changed values */
+    uint32_t written;     /**< Bytes written into the storage, compactions included */
+    uint32_t compactions;
+    uint32_t lastSave;    /**< Milliseconds */
+    uint32_t maxSave;
+} Cli_StoreStatistics;
+
+static Cli_Parameter Cli_parameters[LOCCIONI_CLI_PARAMETERS_MAX];
+static uint8_t Cli_parameterIndex = 0;
+
+static const Cli_Storage* Cli_storage = 0;
+/** Bank with the highest sequence number, and the end of its log. */
+static uint8_t Cli_storeBank = 0;
+static uint32_t Cli_storeSequence = 0;
+static uint32_t Cli_storeOffset = 0;
+static bool Cli_storeValid = FALSE;
+/** A record is broken: the next save compacts instead of appending. */
+static bool Cli_storeDamaged = FALSE;
+static Cli_StoreStatistics Cli_storeStatistics;
+
+static Cli_Parameter* Cli_getParameter (const char* name)
+{
+    uint8_t i;
+
+    for (i = 0; i < Cli_parameterIndex; ++i)
+    {
+        if (strcmp(Cli_parameters[i].argument->name,name) == 0)
+            return &Cli_parameters[i];
+    }
+    return 0;
+}
+
+bool Cli_registerParameter (const Cli_Argument* argument, void* value, uint8_t size)
+{
+    bool valid = FALSE;
+
+    switch (argument->type)
+    {
+    case CLI_ARGTYPE_INT:
+    case CLI_ARGTYPE_HEX:
+        valid = (size == 1) || (size == 2) || (size == 4);
+        break;
+    case CLI_ARGTYPE_FLOAT:
+    case CLI_ARGTYPE_IPV4:
+        valid = (size == 4);
+        break;
+    case CLI_ARGTYPE_MAC:
+        valid = (size == 6);
+        break;
+    case CLI_ARGTYPE_KEYWORD:
+        valid = (size == 1);
+        break;
+    case CLI_ARGTYPE_STRING:
+        valid = (size >= 2) && (size <= LOCCIONI_CLI_PARAMETER_SIZE);
+        break;
+    }
+
+    if (!valid || (Cli_parameterIndex == LOCCIONI_CLI_PARAMETERS_MAX) ||
+        (strlen(argument->name) > CLI_PARAMETER_NAME_SIZE) || (Cli_getParameter(argument->name) != 0))
+        return FALSE;
+
+    Cli_parameters[Cli_parameterIndex].argument = argument;
+    Cli_parameters[Cli_parameterIndex].value    = value;
+    Cli_parameters[Cli_parameterIndex].size     = size;
+    Cli_parameters[Cli_parameterIndex].dirty    = FALSE;
+    Cli_parameterIndex++;
+    return TRUE;
+}
+
+void Cli_setParameterChanged (const void* value)
+{
+    uint8_t i;
+
+    for (i = 0; i < Cli_parameterIndex; ++i)
+    {
+        if (Cli_parameters[i].value == value)
+            Cli_parameters[i].dirty = TRUE;
+    }
+}
+
+/**
+ * An INT parameter is signed, unless its range has no negative values.
+ */
+static bool Cli_isParameterSigned (const Cli_Argument* argument)
+{
+    return (argument->type == CLI_ARGTYPE_INT) &&
+           !((argument->min < argument->max) && (argument->min >= 0));
+}
+
+static int32_t Cli_getParameterInteger (const Cli_Parameter* parameter)
+{
+    bool sign = Cli_isParameterSigned(parameter->argument);
+
+    switch (parameter->size)
+    {
+    case 1:
+        return sign ? *(int8_t*)parameter->value : *(uint8_t*)parameter->value;
+    case 2:
+        return sign ? *(int16_t*)parameter->value : *(uint16_t*)parameter->value;
+    default:
+        return *(int32_t*)parameter->value;
+    }
+}
+
+/**
+ * Copy a parsed value into the variable of the parameter.
+ *
+ * @return FALSE when the value does not fit
+ */
+static bool Cli_setParameterValue (Cli_Parameter* parameter, const Cli_Value* value)
+{
+    uint8_t data[LOCCIONI_CLI_PARAMETER_SIZE];
+    uint32_t integer = (uint32_t)value->integer;
+    uint16_t half = integer;
+    uint8_t bits = parameter->size * 8;
+
+    switch (parameter->argument->type)
+    {
+    case CLI_ARGTYPE_INT:
+    case CLI_ARGTYPE_HEX:
+    case CLI_ARGTYPE_KEYWORD:
+        /* Signed or unsigned, the value must fit the variable. */
+        if (bits < 32)
+        {
+            if (Cli_isParameterSigned(parameter->argument))
+            {
+                if ((value->integer < -(1L << (bits - 1))) || (value->integer > ((1L << (bits - 1)) - 1)))
+                    return FALSE;
+            }
+            else if (integer >= (1u << bits))
+            {
+                return FALSE;
+            }
+        }
+        if (parameter->size == 1)
+            data[0] = integer;
+        else if (parameter->size == 2)
+            memcpy(data,&half,2);
+        else
+            memcpy(data,&integer,4);
+        break;
+    case CLI_ARGTYPE_FLOAT:
+        memcpy(data,&value->real,4);
+        break;
+    case CLI_ARGTYPE_IPV4:
+        memcpy(data,value->ip,4);
+        break;
+    case CLI_ARGTYPE_MAC:
+        memcpy(data,value->mac,6);
+        break;
+    case CLI_ARGTYPE_STRING:
+        if (strlen(value->string) >= parameter->size)
+            return FALSE;
+        memset(data,0,parameter->size);
+        strcpy((char*)data,value->string);
+        break;
+    }
+
+    /* Writing the same value does not cost a record. */
+    if (memcmp(parameter->value,data,parameter->size) != 0)
+    {
+        memcpy(parameter->value,data,parameter->size);
+        parameter->dirty = TRUE;
+    }
+    return TRUE;
+}
+
+/**
+ * Send a float with 3 decimals: %.3q takes an int, so from 1e6 on the
+ * value is sent as d.ddde+N.
+ */
+static void Cli_sendParameterFloat (char* name, float real, const char* mark)
+{
+    const char* sign = (real < 0) ? "-" : "";
+    float magnitude = (real < 0) ? -real : real;
+    uint32_t mantissa;
+    uint8_t exponent = 0;
+
+    if (real != real)
+    {
+        Cli_sendStatusf(name,"nan%s",mark);
+        return;
+    }
+    if (magnitude < 1e6f)
+    {
+        Cli_sendStatusf(name,"%.3q%s",(int)(real * 1000.0f + ((real < 0) ? -0.5f : 0.5f)),mark);
+        return;
+    }
+
+    while ((magnitude >= 10.0f) && (exponent <= 38))
+    {
+        magnitude /= 10.0f;
+        exponent++;
+    }
+    if (magnitude >= 10.0f)
+    {
+        Cli_sendStatusf(name,"%sinf%s",sign,mark);
+        return;
+    }
+    mantissa = magnitude * 1000.0f + 0.5f;
+    /* 9.9996 is rounded to 10.000. */
+    if (mantissa >= 10000)
+    {
+        mantissa /= 10;
+        exponent++;
+    }
+    Cli_sendStatusf(name,"%s%.3qe+%u%s",sign,(int)mantissa,exponent,mark);
+}
+
+static void Cli_sendParameter (const Cli_Parameter* parameter)
+{
+    const Cli_Argument* argument = parameter->argument;
+    char* name = (char*)argument->name;
+    const char* mark = parameter->dirty ? " *" : "";
+    int32_t integer;
+    float real;
+
+    switch (argument->type)
+    {
+    case CLI_ARGTYPE_INT:
+        Cli_sendStatusf(name,"%ld%s",(long)Cli_getParameterInteger(parameter),mark);
+        break;
+    case CLI_ARGTYPE_HEX:
+        Cli_sendStatusf(name,"0x%lX%s",(unsigned long)(uint32_t)Cli_getParameterInteger(parameter),mark);
+        break;
+    case CLI_ARGTYPE_FLOAT:
+        memcpy(&real,parameter->value,4);
+        Cli_sendParameterFloat(name,real,mark);
+        break;
+    case CLI_ARGTYPE_IPV4:
+        Cli_sendStatusf(name,"%I%s",parameter->value,mark);
+        break;
+    case CLI_ARGTYPE_MAC:
+        Cli_sendStatusf(name,"%M%s",parameter->value,mark);
+        break;
+    case CLI_ARGTYPE_KEYWORD:
+        for (integer = 0; argument->keywords[integer] != 0; ++integer)
+        {
+            if (integer == *(uint8_t*)parameter->value)
+                break;
+        }
+        Cli_sendStatusf(name,"%s%s",(argument->keywords[integer] != 0) ? argument->keywords[integer] : "?",mark);
+        break;
+    case CLI_ARGTYPE_STRING:
+        Cli_sendStatusf(name,"%s%s",(char*)parameter->value,mark);
+        break;
+    }
+}
+
+/**
+ * Append the record of a parameter to the log of bank.
+ *
+ * @return FALSE when the bank is full or the storage fails
+ */
+static bool Cli_storeRecord (const Cli_Parameter* parameter, uint8_t bank, uint32_t* offset)
+{
+    uint8_t record[CLI_PARAMETER_RECORD_SIZE];
+    uint8_t nameLength = strlen(parameter->argument->name);
+    uint16_t length = 0;
+    uint16_t crc = 0xFFFF;
+    uint16_t i;
+
+    record[length++] = nameLength;
+    record[length++] = parameter->size;
+    memcpy(&record[length],parameter->argument->name,nameLength);
+    length += nameLength;
+    memcpy(&record[length],parameter->value,parameter->size);
+    length += parameter->size;
+
+    for (i = 0; i < length; ++i)
+        crc = Cli_crc16(crc,record[i]);
+    record[length++] = crc & 0xFF;
+    record[length++] = crc >> 8;
+    while ((length % LOCCIONI_CLI_STORAGE_ALIGN) != 0)
+        record[length++] = 0xFF;
+
+    if ((*offset + length) > Cli_storage->size)
+        return FALSE;
+
+    if (!Cli_storage->write(Cli_storage->handle,bank * Cli_storage->size + *offset,record,length))
+    {
+        Cli_storeDamaged = TRUE;
+        return FALSE;
+    }
+    *offset += length;
+    Cli_storeStatistics.written += length;
+    Cli_storeStatistics.records++;
+    return TRUE;
+}
+
+/**
+ * Write every parameter into the other bank, then its header with the
+ * next sequence number: until the header is written the old bank is
+ * the valid one.
+ */
+static bool Cli_storeCompact (void)
+{
+    uint8_t bank = Cli_storeValid ? (1 - Cli_storeBank) : 0;
+    uint32_t header[2] = {CLI_PARAMETER_MAGIC, Cli_storeSequence + 1};
+    uint32_t offset = CLI_PARAMETER_HEADER_SIZE;
+    uint8_t i;
+
+    if (!Cli_storage->erase(Cli_storage->handle,bank))
+        return FALSE;
+
+    for (i = 0; i < Cli_parameterIndex; ++i)
+    {
+        if (!Cli_storeRecord(&Cli_parameters[i],bank,&offset))
+            return FALSE;
+    }
+    if (!Cli_storage->write(Cli_storage->handle,bank * Cli_storage->size,header,CLI_PARAMETER_HEADER_SIZE))
+        return FALSE;
+
+    Cli_storeStatistics.written += CLI_PARAMETER_HEADER_SIZE;
+    Cli_storeStatistics.compactions++;
+
+    Cli_storeBank     = bank;
+    Cli_storeSequence = header[1];
+    Cli_storeOffset   = offset;
+    Cli_storeValid    = TRUE;
+    Cli_storeDamaged  = FALSE;
+    for (i = 0; i < Cli_parameterIndex; ++i)
+        Cli_parameters[i].dirty = FALSE;
+    return TRUE;
+}
+
+bool Cli_loadParameters (const Cli_Storage* storage)
+{
+    uint8_t record[CLI_PARAMETER_RECORD_SIZE];
+    char name[CLI_PARAMETER_NAME_SIZE + 1];
+    Cli_Parameter* parameter;
+    uint32_t header[2];
+    uint32_t address;
+    uint32_t offset;
+    uint16_t length;
+    uint16_t crc;
+    uint16_t i;
+    uint8_t bank;
+
+    Cli_storage = storage;
+    Cli_storeValid = FALSE;
+    Cli_storeDamaged = FALSE;
+
+    for (bank = 0; bank < 2; ++bank)
+    {
+        if (!storage->read(storage->handle,bank * storage->size,header,CLI_PARAMETER_HEADER_SIZE) ||
+            (header[0] != CLI_PARAMETER_MAGIC))
+            continue;
+
+        if (!Cli_storeValid || ((int32_t)(header[1] - Cli_storeSequence) > 0))
+        {
+            Cli_storeValid    = TRUE;
+            Cli_storeBank     = bank;
+            Cli_storeSequence = header[1];
+        }
+    }
+    if (!Cli_storeValid)
+        return FALSE;
+
+    /* Replay the log: the last record of a parameter wins. */
+    address = Cli_storeBank * storage->size;
+    for (offset = CLI_PARAMETER_HEADER_SIZE; (offset + 2) <= storage->size; offset += length)
+    {
+        if (!storage->read(storage->handle,address + offset,record,2))
+            break;
+        if (record[0] == 0xFF)
+        {
+            /* End of the log, only if no write was interrupted beyond it. */
+            length = CLI_PARAMETER_RECORD_SIZE;
+            if ((offset + length) > storage->size)
+                length = storage->size - offset;
+            storage->read(storage->handle,address + offset,record,length);
+            for (i = 0; i < length; ++i)
+                Cli_storeDamaged = Cli_storeDamaged || (record[i] != 0xFF);
+            break;
+        }
+
+        length = (4 + record[0] + record[1] + LOCCIONI_CLI_STORAGE_ALIGN - 1) & ~(LOCCIONI_CLI_STORAGE_ALIGN - 1);
+        if ((record[0] == 0) || (record[0] > CLI_PARAMETER_NAME_SIZE) ||
+            (record[1] > LOCCIONI_CLI_PARAMETER_SIZE) || ((offset + length) > storage->size) ||
+            !storage->read(storage->handle,address + offset,record,length))
+        {
+            Cli_storeDamaged = TRUE;
+            break;
+        }
+
+        crc = 0xFFFF;
+        for (i = 0; i < (2 + record[0] + record[1]); ++i)
+            crc = Cli_crc16(crc,record[i]);
+        if ((record[i] != (crc & 0xFF)) || (record[i + 1] != (crc >> 8)))
+        {
+            Cli_storeDamaged = TRUE;
+            break;
+        }
+
+        /* Parameters no longer registered are dropped at the next compaction. */
+        memcpy(name,&record[2],record[0]);
+        name[record[0]] = '\0';
+        parameter = Cli_getParameter(name);
+        if ((parameter != 0) && (parameter->size == record[1]))
+            memcpy(parameter->value,&record[2 + record[0]],record[1]);
+    }
+    Cli_storeOffset = offset;
+
+    for (i = 0; i < Cli_parameterIndex; ++i)
+        Cli_parameters[i].dirty = FALSE;
+    return TRUE;
+}
+
+bool Cli_saveParameters (void)
+{
+    uint32_t start = LOCCIONI_CLI_MILLISECONDS();
+    bool result = TRUE;
+    uint8_t i;
+
+    if (Cli_storage == 0)
+        return FALSE;
+
+    for (i = 0; i < Cli_parameterIndex; ++i)
+    {
+        if (Cli_parameters[i].dirty)
+            Cli_storeStatistics.payload += Cli_parameters[i].size;
+    }
+
+    if (!Cli_storeValid || Cli_storeDamaged)
+    {
+        result = Cli_storeCompact();
+    }
+    else
+    {
+        for (i = 0; i < Cli_parameterIndex; ++i)
+        {
+            if (!Cli_parameters[i].dirty)
+                continue;
+            /* Log full: the compaction writes the rest too. */
+            if (!Cli_storeRecord(&Cli_parameters[i],Cli_storeBank,&Cli_storeOffset))
+            {
+                result = Cli_storeCompact();
+                break;
+            }
+            Cli_parameters[i].dirty = FALSE;
+        }
+    }
+
+    Cli_storeStatistics.saves++;
+    Cli_storeStatistics.lastSave = LOCCIONI_CLI_MILLISECONDS() - start;
+    if (Cli_storeStatistics.lastSave > Cli_storeStatistics.maxSave)
+        Cli_storeStatistics.maxSave = Cli_storeStatistics.lastSave;
+    return result;
+}
+
+static void Cli_parameterList (void* device, int argc, char* argv[])
+{
+    uint8_t i;
+
+    if (argc != 1)
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    for (i = 0; i < Cli_parameterIndex; ++i)
+        Cli_sendParameter(&Cli_parameters[i]);
+}
+
+static void Cli_parameterGet (void* device, int argc, char* argv[])
+{
+    Cli_Parameter* parameter = (argc == 2) ? Cli_getParameter(argv[1]) : 0;
+
+    if (parameter == 0)
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    Cli_sendParameter(parameter);
+}
+
+static void Cli_parameterSet (void* device, int argc, char* argv[])
+{
+    Cli_Parameter* parameter = (argc == 3) ? Cli_getParameter(argv[1]) : 0;
+    Cli_Value value;
+
+    if (parameter == 0)
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    if (!Cli_parseArgument(parameter->argument,argv[2],&value) ||
+        !Cli_setParameterValue(parameter,&value))
+    {
+        Cli_context->commandError = TRUE;
+        Cli_printf("ERR: %s must be ",parameter->argument->name);
+        Cli_putArgumentType(parameter->argument);
+        Cli_puts("\r\n");
+        return;
+    }
+    LOCCIONI_CLI_DONECMD();
+}
+
+static void Cli_parameterCompact (void* device, int argc, char* argv[])
+{
+    if ((argc != 1) || (Cli_storage == 0))
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    if (!Cli_storeCompact())
+    {
+        Cli_sendError("ERR: storage write failed");
+        return;
+    }
+    LOCCIONI_CLI_DONECMD();
+}
+
+static void Cli_parameterStatus (void* device, int argc, char* argv[])
+{
+    const Cli_StoreStatistics* statistics = &Cli_storeStatistics;
+
+    if (argc != 1)
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    if (Cli_storage == 0)
+    {
+        Cli_sendStatusString("storage","none","");
+        return;
+    }
+
+    Cli_sendStatusf("bank","%u, sequence %lu%s",Cli_storeBank,(unsigned long)Cli_storeSequence,
+                    Cli_storeDamaged ? ", damaged" : "");
+    Cli_sendStatusf("used","%lu of %lu bytes",(unsigned long)Cli_storeOffset,(unsigned long)Cli_storage->size);
+    Cli_sendStatusf("saves","%lu, %lu records",(unsigned long)statistics->saves,(unsigned long)statistics->records);
+    Cli_sendStatusf("compactions","%lu",(unsigned long)statistics->compactions);
+    Cli_sendStatusf("written","%lu bytes, %lu of changed values",
+                    (unsigned long)statistics->written,(unsigned long)statistics->payload);
+    /* Bytes written for every byte changed. */
+    Cli_sendStatusf("amplification","%.2q",
+                    (statistics->payload != 0) ? (int)(statistics->written * 100 / statistics->payload) : 0);
+    Cli_sendStatusf("save time","%lu ms, max %lu ms",
+                    (unsigned long)statistics->lastSave,(unsigned long)statistics->maxSave);
+}
+
+#endif /* LOCCIONI_CLI_PARAMETERS */
+
+#if LOCCIONI_CLI_ETHERNET == 1
+
+static uint8_t* Cli_ipAddress      = 0;
+static uint8_t* Cli_gatewayAddress = 0;
+static uint8_t* Cli_maskAddress    = 0;
+static uint8_t* Cli_macAddress     = 0;
+
+#if LOCCIONI_CLI_PARAMETERS == 1
+static const Cli_Argument Cli_networkParameters[] =
+{
+    {.name = "net.ip"  , .type = CLI_ARGTYPE_IPV4},
+    {.name = "net.mask", .type = CLI_ARGTYPE_IPV4},
+    {.name = "net.gw"  , .type = CLI_ARGTYPE_IPV4},
+    {.name = "net.mac" , .type = CLI_ARGTYPE_MAC},
+};
+#endif
+
+void Cli_setNetworkMemoryArray (uint8_t* ip, uint8_t* mask, uint8_t* gw, uint8_t* mac)
+{
+    Cli_ipAddress = ip;
+    Cli_gatewayAddress = gw;
+    Cli_maskAddress = mask;
+    Cli_macAddress = mac;
+
+#if LOCCIONI_CLI_PARAMETERS == 1
+    Cli_registerParameter(&Cli_networkParameters[0],ip,4);
+    Cli_registerParameter(&Cli_networkParameters[1],mask,4);
+    Cli_registerParameter(&Cli_networkParameters[2],gw,4);
+    Cli_registerParameter(&Cli_networkParameters[3],mac,6);
+#endif
+}
+
+static void Cli_networkShow (void* device, int argc, char* argv[])
+{
+    if (argc != 1)
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+
+    Cli_sendStatusf("ip","%I",Cli_ipAddress);
+    Cli_sendStatusf("gateway","%I",Cli_gatewayAddress);
+    Cli_sendStatusf("mask","%I",Cli_maskAddress);
+    Cli_sendStatusf("mac","%M",Cli_macAddress);
+}
+
+static void Cli_networkAddress (void* device, int argc, char* argv[])
+{
+    uint8_t* address = Cli_ipAddress;
+    uint8_t tmp[4];
+
+    if (strcmp(argv[0], "gw") == 0)
+        address = Cli_gatewayAddress;
+    else if (strcmp(argv[0], "mask") == 0)
+        address = Cli_maskAddress;
+
+    // Parsed aside, a wrong value leaves the address unchanged
+    if ((argc != 2) || !Cli_parseBytes(argv[1],4,'.',10,tmp))
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    memcpy(address,tmp,4);
+#if LOCCIONI_CLI_PARAMETERS == 1
+    Cli_setParameterChanged(address);
+#endif
+    LOCCIONI_CLI_DONECMD();
+}
+
+static void Cli_networkMac (void* device, int argc, char* argv[])
+{
+    uint8_t tmp[6];
+
+    if ((argc != 2) || !Cli_parseBytes(argv[1],6,':',16,tmp))
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    memcpy(Cli_macAddress,tmp,6);
+#if LOCCIONI_CLI_PARAMETERS == 1
+    Cli_setParameterChanged(Cli_macAddress);
+#endif
+    LOCCIONI_CLI_DONECMD();
+}
+#endif
+
+static System_Errors (*Cli_saveCallbackFunction)(void) = 0;
+static Cli_TaskFunction Cli_saveTaskFunction = 0;
+
+void Cli_saveCallback (System_Errors (*saveCallback)(void))
+{
+    Cli_saveCallbackFunction = saveCallback;
+}
+
+void Cli_saveTask (Cli_TaskFunction saveTask)
+{
+    Cli_saveTaskFunction = saveTask;
+}
+
+static Cli_TaskStatus Cli_saveFlashTask (Cli_Task* task)
+{
+    Cli_TaskStatus status = Cli_saveTaskFunction(task);
+
+    if (status == CLI_TASKSTATUS_DONE)
+        Cli_sendString("Reboot necessary!");
+    return status;
+}
+
+static void Cli_saveFlash (void* device, int argc, char* argv[])
+{
+    if (argc != 1)
+          return;
+
+    if (!Cli_context->configMode)
+    {
+        Cli_sendError(Cli_notConfigMode);
+        return;
+    }
+
+    Cli_sendString("Saving parameters...");
+
+#if LOCCIONI_CLI_PARAMETERS == 1
+    /* The registry is written at once, and its values are already in use. */
+    if (Cli_storage != 0)
+    {
+        if (!Cli_saveParameters())
+        {
+            Cli_sendError("ERR: storage write failed");
+            return;
+        }
+        if ((Cli_saveTaskFunction == 0) && (Cli_saveCallbackFunction == 0))
+        {
+            LOCCIONI_CLI_DONECMD();
+            return;
+        }
+    }
+#endif
+
+    if (Cli_saveTaskFunction != 0)
+    {
+        Cli_startTask(Cli_saveFlashTask,0,0);
+        return;
+    }
+
+    if (Cli_saveCallbackFunction != 0)
+        Cli_saveCallbackFunction();
+    Cli_sendString("Reboot necessary!");
+}
+
+static void Cli_reboot (void* device, int argc, char* argv[])
+{
+    if (argc != 1)
+          return;
+
+    if (!Cli_context->configMode)
+    {
+        Cli_sendError(Cli_notConfigMode);
+        return;
+    }
+
+    Cli_sendString("Reboot...\r\n");
+    Cli_flush();
+    NVIC_SystemReset();
+}
+
+/**
+ * Binary search of a subcommand into the sorted table of its module.
+ */
+static const Cli_Subcommand* Cli_getSubcommand (const Cli_Command* cmd, const char* name)
+{
+    int16_t first = 0;
+    int16_t last = cmd->numberOfSubcommands - 1;
+    int16_t middle;
+    int result;
+
+    while (first <= last)
+    {
+        middle = (first + last) / 2;
+        result = strcmp(name,cmd->subcommands[middle].name);
+        if (result == 0)
+            return &cmd->subcommands[middle];
+        if (result < 0)
+            last = middle - 1;
+        else
+            first = middle + 1;
+    }
+    return 0;
+}
+
+/**
+ * Help of a module generated from its table: the subcommands that need
+ * the configuration mode are listed only into it.
+ */
+static void Cli_putSubcommands (const Cli_Command* cmd)
+{
+    const Cli_Subcommand* subcommand;
+    uint8_t length;
+    uint8_t i;
+
+    for (i = 0; i < cmd->numberOfSubcommands; ++i)
+    {
+        subcommand = &cmd->subcommands[i];
+        if (subcommand->configMode && !Cli_context->configMode)
+            continue;
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+        if (Cli_isStructured())
+        {
+            Cli_sendHelpString((char*)subcommand->name,(char*)subcommand->description);
+            continue;
+        }
+#endif
+
+        Cli_puts("  ");
+        Cli_puts(subcommand->name);
+        length = strlen(subcommand->name);
+        if (subcommand->arguments != 0)
+        {
+            Cli_putChar(' ');
+            Cli_puts(subcommand->arguments);
+            length += 1 + strlen(subcommand->arguments);
+        }
+        if (length < CLI_MAX_CMD_CHAR_LINE - 2)
+            Cli_putFill(' ',CLI_MAX_CMD_CHAR_LINE - 2 - length);
+        Cli_putChar(';');
+        Cli_putsln(subcommand->description);
+    }
+}
+
+static void Cli_runSubcommand (const Cli_Command* cmd, int argc, char* argv[])
+{
+    const Cli_Subcommand* subcommand;
+
+    if ((argv == 0) || (argc == 1))
+    {
+        Cli_putSubcommands(cmd);
+        return;
+    }
+
+    subcommand = Cli_getSubcommand(cmd,argv[1]);
+    if (subcommand == 0)
+    {
+        LOCCIONI_CLI_WRONGCMD();
+        return;
+    }
+    if (subcommand->configMode && !Cli_context->configMode)
+    {
+        Cli_sendError(Cli_notConfigMode);
+        return;
+    }
+    subcommand->cmdFunction(cmd->device,argc - 1,&argv[1]);
+}
+
+static void Cli_runCommand (const Cli_Command* cmd, int argc, char* argv[])
+{
+#if LOCCIONI_CLI_LEGACY_HANDLER == 1
+    uint8_t i;
+#endif
+
+    if (cmd->subcommands != 0)
+    {
+        Cli_runSubcommand(cmd,argc,argv);
+        return;
+    }
+
+#if LOCCIONI_CLI_TYPED_ARGUMENTS == 1
+    if (cmd->typedFunction != 0)
+    {
+        if (argv != 0)
+            Cli_runTypedCommand(cmd,argc,argv);
+        return;
+    }
+#endif
+
+#if LOCCIONI_CLI_LEGACY_HANDLER == 1
+    if (cmd->cmdFunction == 0)
+    {
+        if (argv == 0)
+        {
+            cmd->legacyFunction(cmd->device,argc,0);
+            return;
+        }
+
+        for (i = 0; i < argc; ++i)
+        {
+            strncpy(Cli_legacyParams[i],argv[i],LOCCIONI_CLI_BUFFER_SIZE - 1);
+            Cli_legacyParams[i][LOCCIONI_CLI_BUFFER_SIZE - 1] = '\0';
+        }
+        cmd->legacyFunction(cmd->device,argc,Cli_legacyParams);
+        return;
+    }
+#endif
+
+    cmd->cmdFunction(cmd->device,argc,argv);
+}
+
+bool Cli_startTask (Cli_TaskFunction function, void* device, void* context)
+{
+    if (Cli_context->task.function != 0)
+        return FALSE;
+
+    Cli_context->task.function = function;
+    Cli_context->task.device   = device;
+    Cli_context->task.context  = context;
+    Cli_context->task.state    = 0;
+    Cli_context->task.progress = 0;
+    Cli_context->task.abort    = FALSE;
+    Cli_context->taskProgress  = 0;
+    return TRUE;
+}
+
+bool Cli_isTaskRunning (void)
+{
+    return Cli_context->task.function != 0;
+}
+
+/**
+ * Call the running task once, reporting its progress.
+ *
+ * @return TRUE when the task has ended
+ */
+static bool Cli_taskStep (void)
+{
+    Cli_TaskStatus status = Cli_context->task.function(&Cli_context->task);
+
+    if ((status == CLI_TASKSTATUS_PENDING) && !Cli_context->task.abort)
+    {
+        if (Cli_context->task.progress != Cli_context->taskProgress)
+        {
+            Cli_context->taskProgress = Cli_context->task.progress;
+            Cli_printf("\rProgress: %u%%",Cli_context->taskProgress);
+        }
+        return FALSE;
+    }
+
+    /* Close the progress line. */
+    if (Cli_context->taskProgress != 0)
+        Cli_puts("\r\n");
+
+    /* After an abort the task has been called for the last time. */
+    if (status == CLI_TASKSTATUS_FAILED)
+        Cli_sendError(Cli_failedCmd);
+    else if (status == CLI_TASKSTATUS_PENDING)
+        Cli_sendError(Cli_abortedCmd);
+
+    Cli_context->task.function = 0;
+    return TRUE;
+}
+
+static void Cli_taskRunToEnd (void)
+{
+    while (!Cli_taskStep())
+    {
+#if LOCCIONI_CLI_TX_BUFFER_SIZE > 0
+        Cli_txDrain(FALSE);
+#endif
+    }
+}
+
+#if LOCCIONI_CLI_FRAMED == 1
+
+
+
+static void Cli_functionFramed (void* device, int argc, char* argv[])
+{
+    LOCCIONI_CLI_DONECMD();
+    Cli_context->framedMode = TRUE;
+    Cli_context->frameIndex = 0;
+    Cli_context->frameEscape = FALSE;
+    Cli_context->frameOverflow = FALSE;
+}
+
+/**
+ * Run a decoded frame: sequence, command identifier, payload and CRC16
+ * (little endian). The reply has the same sequence and identifier,
+ * followed by the data written by the handler, the status and the CRC16.
+ */
+static void Cli_executeFrame (void)
+{
+    const Cli_Command* cmd;
+    uint8_t* payload = &Cli_context->frameBuffer[2];
+    uint16_t length;
+    uint16_t crc = 0xFFFF;
+    uint16_t i;
+    uint8_t status = CLI_FRAMESTATUS_OK;
+    uint8_t id;
+
+    /* Too short to carry sequence, identifier and CRC: line noise. */
+    if (Cli_context->frameIndex < 4)
+        return;
+
+    length = Cli_context->frameIndex - 4;
+    for (i = 0; i < (Cli_context->frameIndex - 2); ++i)
+        crc = Cli_crc16(crc,Cli_context->frameBuffer[i]);
+
+    id = Cli_context->frameBuffer[1];
+    Cli_frameOpen(Cli_context->frameBuffer[0],id);
+
+    if ((Cli_context->frameBuffer[Cli_context->frameIndex - 2] != (crc & 0xFF)) ||
+        (Cli_context->frameBuffer[Cli_context->frameIndex - 1] != (crc >> 8)))
+    {
+        Cli_frameClose(CLI_FRAMESTATUS_CRC);
+        return;
+    }
+    /* The CRC has been checked: its place terminates the last argument. */
+    payload[length] = '\0';
+
+    switch (id)
+    {
+    case CLI_FRAMEID_EXIT:
+        Cli_frameClose(CLI_FRAMESTATUS_OK);
+        Cli_context->framedMode = FALSE;
+        Cli_prompt();
+        return;
+
+    case CLI_FRAMEID_LOOKUP:
+        cmd = Cli_getCommand((char*)payload);
+        if (cmd != 0)
+        {
+            id = Cli_getCommandId(cmd);
+            Cli_frameWrite((const char*)&id,1);
+        }
+        else
+        {
+            status = CLI_FRAMESTATUS_UNKNOWN;
+        }
+        break;
+
+    default:
+        cmd = Cli_getCommandById(id);
+        if (cmd == 0)
+        {
+            status = CLI_FRAMESTATUS_UNKNOWN;
+        }
+        else if (cmd->framedFunction != 0)
+        {
+            status = Cli_dispatchFrame(cmd,payload,length);
+        }
+        else
+        {
+            /* Text handler: the payload holds null separated arguments. */
+            Cli_context->params[0] = cmd->name;
+            Cli_context->numberOfParams = 1;
+            for (i = 0; i < length; i += strlen((char*)&payload[i]) + 1)
+            {
+                if (Cli_context->numberOfParams == CLI_MAX_PARAM)
+                {
+                    status = CLI_FRAMESTATUS_PARAM;
+                    break;
+                }
+                Cli_context->params[Cli_context->numberOfParams++] = (char*)&payload[i];
+            }
+
+            if (status == CLI_FRAMESTATUS_OK)
+            {
+                Cli_context->commandError = FALSE;
+                Cli_context->background = FALSE;
+                Cli_dispatchCommand(cmd,Cli_context->numberOfParams,Cli_context->params);
+                if (Cli_context->task.function != 0) Cli_taskRunToEnd();
+                if (Cli_context->commandError) status = CLI_FRAMESTATUS_FAILED;
+            }
+        }
+        break;
+    }
+
+    Cli_frameClose(status);
+}
+
+static void Cli_receiveFrameChar (uint8_t c)
+{
+    if (c == CLI_SLIP_END)
+    {
+        if (Cli_context->frameOverflow)
+        {
+            Cli_context->rxStatistics.discarded += Cli_context->frameIndex;
+            Cli_frameOpen(0,CLI_FRAMEID_LOOKUP);
+            Cli_frameClose(CLI_FRAMESTATUS_OVERFLOW);
+        }
+        else
+        {
+            Cli_executeFrame();
+        }
+
+        Cli_context->frameIndex = 0;
+        Cli_context->frameEscape = FALSE;
+        Cli_context->frameOverflow = FALSE;
+        return;
+    }
+
+    if (Cli_context->frameEscape)
+    {
+        if (c == CLI_SLIP_ESC_END) c = CLI_SLIP_END;
+        else if (c == CLI_SLIP_ESC_ESC) c = CLI_SLIP_ESC;
+        Cli_context->frameEscape = FALSE;
+    }
+    else if (c == CLI_SLIP_ESC)
+    {
+        Cli_context->frameEscape = TRUE;
+        return;
+    }
+
+    /* Keep one byte to terminate the last argument. */
+    if (Cli_context->frameIndex >= (LOCCIONI_CLI_FRAME_SIZE - 1))
+    {
+        Cli_context->frameOverflow = TRUE;
+        return;
+    }
+    Cli_context->frameBuffer[Cli_context->frameIndex++] = c;
+}
+
+bool Cli_isFramedMode (void)
+{
+    return Cli_context->framedMode;
+}
+
+void Cli_sendData (const void* data, uint16_t length)
+{
+    Cli_write(data,length);
+}
+
+#endif /* LOCCIONI_CLI_FRAMED */
+
+/**
+ * Run a command of the parsed line.
+ *
+ * @param background When FALSE, a task started by the command is run to
+ *                   the end before returning
+ * @return FALSE when the command is unknown or has called Cli_sendError
+ */
+static bool Cli_executeCommand (const Cli_LineCommand* command, bool background)
+{
+    Cli_context->commandError = FALSE;
+    Cli_context->background = background;
+
+    if (command->wrongParam)
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return FALSE;
+    }
+    if (command->cmd == 0)
+    {
+        Cli_sendError(Cli_notFoundCmd);
+        return FALSE;
+    }
+
+    Cli_dispatchCommand(command->cmd,
+                        command->numberOfParams,
+                        &Cli_context->params[command->firstParam]);
+
+    if ((Cli_context->task.function != 0) && !background)
+        Cli_taskRunToEnd();
+    return !Cli_context->commandError;
+}
+
+/**
+ * Run the commands of the parsed line, stopping at the first one that
+ * fails.
+ *
+ * @param count Incremented for every command executed
+ * @param background When TRUE and the line holds a single command, a task
+ *                   started by it goes on in the following Cli_check calls
+ * @return FALSE when a command has failed
+ */
+static bool Cli_executeLine (uint8_t* count, bool background)
+{
+    uint8_t i;
+
+    Cli_lineCommandEnd();
+    if (Cli_context->lineOverflow)
+    {
+        (*count)++;
+        LOCCIONI_CLI_WRONGPARAM();
+        return FALSE;
+    }
+
+    for (i = 0; i < Cli_context->numberOfCommands; ++i)
+    {
+        (*count)++;
+        if (!Cli_executeCommand(&Cli_context->lineCommands[i],
+                                background && (Cli_context->numberOfCommands == 1)))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void Cli_sendBatchResult (bool done, uint8_t count)
+{
+    Cli_printf(done ? "Batch done: %u\r\n" : "ERR: Batch stopped at command %u\r\n",count);
+}
+
+#if LOCCIONI_CLI_BATCH_SIZE > 0
+
+static void Cli_functionBatch (void* device, int argc, char* argv[])
+{
+    if ((argc == 2) && (strcmp(argv[1],"begin") == 0) && !Cli_context->batchRunning)
+    {
+        Cli_context->batchOpen = TRUE;
+        Cli_context->batchOverflow = FALSE;
+        Cli_context->batchIndex = 0;
+        return;
+    }
+
+    if (argc == 1)
+    {
+        Cli_sendHelpString("begin","Start queueing lines");
+        Cli_sendHelpString("end","Run the queued lines, stop at the first error");
+        Cli_sendHelpString("abort","Discard the queued lines");
+        return;
+    }
+
+    LOCCIONI_CLI_WRONGPARAM();
+}
+
+/**
+ * Keyword of a "batch <keyword>" line, from the tokens parsed while the
+ * line arrived: blanks and quotes count as for any other command.
+ *
+ * @return Null when the line is not a single batch command
+ */
+static const char* Cli_batchKeyword (void)
+{
+    const Cli_LineCommand* command = &Cli_context->lineCommands[0];
+
+    Cli_lineCommandEnd();
+    if (Cli_context->lineOverflow || (Cli_context->numberOfCommands != 1) ||
+        (command->numberOfParams != 2) ||
+        (strcmp(Cli_context->params[command->firstParam],"batch") != 0))
+        return 0;
+    return Cli_context->params[command->firstParam + 1];
+}
+
+/**
+ * Store a line received while the batch is open, or run the batch when
+ * the line is "batch end".
+ */
+static void Cli_batchLine (char* line, uint8_t length)
+{
+    const char* keyword = Cli_batchKeyword();
+    uint16_t i;
+    uint8_t j;
+    uint8_t count = 0;
+    bool done = TRUE;
+
+    line[length] = '\0';
+
+    if ((keyword != 0) && (strcmp(keyword,"abort") == 0))
+    {
+        Cli_context->batchOpen = FALSE;
+        LOCCIONI_CLI_DONECMD();
+        return;
+    }
+
+    if ((keyword == 0) || (strcmp(keyword,"end") != 0))
+    {
+        if ((Cli_context->batchIndex + length + 1) > LOCCIONI_CLI_BATCH_SIZE)
+        {
+            Cli_context->batchOverflow = TRUE;
+            return;
+        }
+        memcpy(&Cli_context->batchBuffer[Cli_context->batchIndex],line,length + 1);
+        Cli_context->batchIndex += length + 1;
+        return;
+    }
+
+    Cli_context->batchOpen = FALSE;
+    if (Cli_context->batchOverflow)
+    {
+        Cli_sendError("ERR: Batch too long, discarded");
+        return;
+    }
+
+    Cli_context->batchRunning = TRUE;
+    for (i = 0; done && (i < Cli_context->batchIndex); i += length + 1)
+    {
+        length = strlen(&Cli_context->batchBuffer[i]);
+
+        Cli_lineReset();
+        for (j = 0; j < length; ++j)
+            Cli_lineFeed(Cli_context->batchBuffer[i + j]);
+        done = Cli_executeLine(&count,FALSE);
+    }
+    Cli_context->batchRunning = FALSE;
+
+    Cli_sendBatchResult(done,count);
+}
+
+#endif /* LOCCIONI_CLI_BATCH_SIZE */
+
+#if LOCCIONI_CLI_BAUD == 1
+
+/** Rates listed by "baud" when the transport can generate them. */
+static const uint32_t Cli_baudrates[] =
+{
+    9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600,
+    1000000, 1500000, 2000000, 3000000,
+};
+
+/**
+ * Wait for the host to send "ok" at the new rate, otherwise go back to the
+ * previous one.
+ */
+static Cli_TaskStatus Cli_baudTask (Cli_Task* task)
+{
+    const Cli_Transport* transport = Cli_context->transport;
+    bool confirmed;
+
+    if (task->abort || ((LOCCIONI_CLI_MILLISECONDS() - Cli_context->baudStart) >= LOCCIONI_CLI_BAUD_TIMEOUT))
+    {
+        transport->setBaudrate(transport->handle,Cli_context->baudPrevious,TRUE);
+        Cli_context->baudrate = Cli_context->baudPrevious;
+        if (task->abort)
+            return CLI_TASKSTATUS_PENDING;
+
+        Cli_printf("\r\nNo confirmation, back to %lu baud\r\n",(unsigned long)Cli_context->baudrate);
+        return CLI_TASKSTATUS_FAILED;
+    }
+
+    if (!Cli_context->linePending)
+        return CLI_TASKSTATUS_PENDING;
+
+    /* The line is for this task: it is not executed. */
+    Cli_lineCommandEnd();
+    confirmed = (Cli_context->numberOfCommands == 1) &&
+                (Cli_context->lineCommands[0].numberOfParams == 1) &&
+                (strcmp(Cli_context->params[0],"ok") == 0);
+    Cli_context->linePending = FALSE;
+    Cli_context->bufferIndex = 0;
+#if LOCCIONI_CLI_EDITOR == 1
+    Cli_context->cursor = 0;
+#endif
+    Cli_lineReset();
+
+    if (!confirmed)
+        return CLI_TASKSTATUS_PENDING;
+
+    Cli_printf("\r\nBaud rate %lu\r\n",(unsigned long)Cli_context->baudrate);
+    return CLI_TASKSTATUS_DONE;
+}
+
+static void Cli_functionBaud (void* device, int argc, char* argv[])
+{
+    const Cli_Transport* transport = Cli_context->transport;
+    uint32_t baudrate;
+    char* end;
+    uint8_t i;
+
+    if (argc == 1)
+    {
+        Cli_sendStatusf("baudrate","%lu",(unsigned long)Cli_context->baudrate);
+        if (transport->setBaudrate == 0)
+            return;
+
+        Cli_putPadded("supported",CLI_MAX_CMD_CHAR_LINE);
+        Cli_puts(":");
+        for (i = 0; i < (sizeof(Cli_baudrates) / sizeof(Cli_baudrates[0])); ++i)
+        {
+            if (transport->setBaudrate(transport->handle,Cli_baudrates[i],FALSE))
+                Cli_printf(" %lu",(unsigned long)Cli_baudrates[i]);
+        }
+        Cli_puts("\r\n");
+        return;
+    }
+
+    baudrate = strtoul(argv[1],&end,10);
+    if ((argc != 2) || (*end != '\0') || (baudrate == 0))
+    {
+        Cli_sendHelpString("<rate>","Change the rate, confirm sending \"ok\" at the new one");
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    if (transport->setBaudrate == 0)
+    {
+        Cli_sendError("ERR: The transport has no baud rate");
+        return;
+    }
+    if (!transport->setBaudrate(transport->handle,baudrate,FALSE))
+    {
+        Cli_sendError("ERR: Baud rate not supported");
+        return;
+    }
+    /* The confirmation is the next line. */
+    if (!Cli_context->background)
+    {
+        Cli_sendError("ERR: baud must be the only command of the line");
+        return;
+    }
+
+    Cli_printf("Switching to %lu baud, send \"ok\" within %u ms\r\n",
+               (unsigned long)baudrate,LOCCIONI_CLI_BAUD_TIMEOUT);
+    Cli_flush();
+
+    transport->setBaudrate(transport->handle,baudrate,TRUE);
+    Cli_context->baudPrevious = Cli_context->baudrate;
+    Cli_context->baudrate = baudrate;
+    Cli_context->baudStart = LOCCIONI_CLI_MILLISECONDS();
+    Cli_startTask(Cli_baudTask,0,0);
+}
+
+#endif /* LOCCIONI_CLI_BAUD */
+
+#if LOCCIONI_CLI_TRANSFER == 1
+
+typedef struct _Cli_DataEndpoint
+{
+    char* name;
+    void* device;
+    uint32_t size;
+    Cli_DataRead read;
+    Cli_DataWrite write;
+} Cli_DataEndpoint;
+
+static Cli_DataEndpoint Cli_dataTable[LOCCIONI_CLI_TRANSFER_ENDPOINTS];
+static uint8_t Cli_dataIndex = 0;
+
+bool Cli_registerData (char* name,
+                       void* device,
+                       uint32_t size,
+                       Cli_DataRead read,
+                       Cli_DataWrite write)
+{
+    /* Larger blocks would wrap the sequence numbers and seem complete. */
+    if ((Cli_dataIndex == LOCCIONI_CLI_TRANSFER_ENDPOINTS) || (size > CLI_TRANSFER_MAX_SIZE))
+        return FALSE;
+
+    Cli_dataTable[Cli_dataIndex].name   = name;
+    Cli_dataTable[Cli_dataIndex].device = device;
+    Cli_dataTable[Cli_dataIndex].size   = size;
+    Cli_dataTable[Cli_dataIndex].read   = read;
+    Cli_dataTable[Cli_dataIndex].write  = write;
+    Cli_dataIndex++;
+    return TRUE;
+}
+
+static const Cli_DataEndpoint* Cli_getData (const char* name)
+{
+    uint8_t i;
+
+    for (i = 0; i < Cli_dataIndex; ++i)
+    {
+        if (strcmp(Cli_dataTable[i].name,name) == 0)
+            return &Cli_dataTable[i];
+    }
+    return 0;
+}
+
+static void Cli_transferSend (uint8_t type, uint16_t sequence, const uint8_t* data, uint8_t length)
+{
+    uint8_t header[5] = {CLI_TRANSFER_SYNC, type, sequence & 0xFF, sequence >> 8, length};
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    for (i = 1; i < 5; ++i)
+        crc = Cli_crc16(crc,header[i]);
+    for (i = 0; i < length; ++i)
+        crc = Cli_crc16(crc,data[i]);
+
+    /* The packets skip Cli_write, that drops text while transferring. */
+    Cli_writeRaw((const char*)header,5);
+    Cli_writeRaw((const char*)data,length);
+    header[0] = crc & 0xFF;
+    header[1] = crc >> 8;
+    Cli_writeRaw((const char*)header,2);
+}
+
+static bool Cli_transferSendChunk (uint16_t chunk)
+{
+    uint8_t data[LOCCIONI_CLI_TRANSFER_CHUNK];
+    uint32_t offset = (uint32_t)chunk * LOCCIONI_CLI_TRANSFER_CHUNK;
+    uint16_t length = LOCCIONI_CLI_TRANSFER_CHUNK;
+
+    if (length > (Cli_context->transferSize - offset))
+        length = Cli_context->transferSize - offset;
+    if (Cli_context->transferData->read(Cli_context->transferData->device,offset,data,length) != length)
+        return FALSE;
+
+    Cli_transferSend(CLI_TRANSFER_DATA,chunk,data,length);
+    return TRUE;
+}
+
+static void Cli_transferSendEnd (void)
+{
+    uint8_t size[4];
+
+    size[0] = Cli_context->transferSize & 0xFF;
+    size[1] = (Cli_context->transferSize >> 8) & 0xFF;
+    size[2] = (Cli_context->transferSize >> 16) & 0xFF;
+    size[3] = Cli_context->transferSize >> 24;
+    Cli_transferSend(CLI_TRANSFER_END,Cli_context->transferBase,size,4);
+}
+
+static void Cli_transferSendAck (void)
+{
+    Cli_transferSend(CLI_TRANSFER_ACK,Cli_context->transferBase,&Cli_context->transferBitmap,1);
+}
+
+/**
+ * Send again the chunks of the window not acknowledged, before limit.
+ */
+static bool Cli_transferSendMissing (uint16_t limit)
+{
+    uint16_t chunk;
+
+    for (chunk = Cli_context->transferBase; chunk < limit; ++chunk)
+    {
+        if ((Cli_context->transferBitmap & (1 << (chunk - Cli_context->transferBase))) == 0)
+        {
+            if (!Cli_transferSendChunk(chunk))
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void Cli_transferFail (void)
+{
+    Cli_transferSend(CLI_TRANSFER_ABORT,0,0,0);
+    Cli_context->transferStatus = CLI_TASKSTATUS_FAILED;
+}
+
+static void Cli_transferReceiveData (uint16_t sequence, const uint8_t* data, uint8_t length)
+{
+    const Cli_DataEndpoint* endpoint = Cli_context->transferData;
+    uint32_t offset = (uint32_t)sequence * LOCCIONI_CLI_TRANSFER_CHUNK;
+    uint8_t bit;
+
+    /* Already received, only the acknowledge was lost. */
+    if ((sequence < Cli_context->transferBase) ||
+        (sequence >= Cli_context->transferBase + LOCCIONI_CLI_TRANSFER_WINDOW))
+    {
+        Cli_transferSendAck();
+        return;
+    }
+
+    bit = 1 << (sequence - Cli_context->transferBase);
+    if ((Cli_context->transferBitmap & bit) == 0)
+    {
+        if (((offset + length) > endpoint->size) ||
+            !endpoint->write(endpoint->device,offset,data,length))
+        {
+            Cli_transferFail();
+            return;
+        }
+        Cli_context->transferBitmap |= bit;
+        if ((offset + length) > Cli_context->transferSize)
+            Cli_context->transferSize = offset + length;
+    }
+
+    while (Cli_context->transferBitmap & 1)
+    {
+        Cli_context->transferBitmap >>= 1;
+        Cli_context->transferBase++;
+    }
+    Cli_transferSendAck();
+}
+
+static void Cli_transferReceiveEnd (uint16_t sequence, const uint8_t* data, uint8_t length)
+{
+    const Cli_DataEndpoint* endpoint = Cli_context->transferData;
+    uint32_t size;
+
+    /* Already committed, the confirmation was lost. */
+    if (Cli_context->transferEnd)
+    {
+        Cli_transferSendEnd();
+        return;
+    }
+
+    /* Some chunks are still missing. */
+    if ((length != 4) || (sequence != Cli_context->transferBase))
+    {
+        Cli_transferSendAck();
+        return;
+    }
+
+    size = data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    if ((size != Cli_context->transferSize) ||
+        (((size + LOCCIONI_CLI_TRANSFER_CHUNK - 1) / LOCCIONI_CLI_TRANSFER_CHUNK) != sequence) ||
+        !endpoint->write(endpoint->device,size,0,0))
+    {
+        Cli_transferFail();
+        return;
+    }
+    /*
+     * The task ends after a timeout without packets, answering again if
+     * the confirmation is lost.
+     */
+    Cli_transferSendEnd();
+    Cli_context->transferEnd = TRUE;
+}
+
+static void Cli_transferPacket (uint8_t type, uint16_t sequence, const uint8_t* data, uint8_t length)
+{
+    uint8_t last;
+
+    if (type == CLI_TRANSFER_ABORT)
+    {
+        Cli_context->transferStatus = CLI_TASKSTATUS_FAILED;
+        return;
+    }
+
+    if (!Cli_context->transferSending)
+    {
+        Cli_context->transferLast = LOCCIONI_CLI_MILLISECONDS();
+        Cli_context->transferRetries = 0;
+        if ((type == CLI_TRANSFER_DATA) && !Cli_context->transferEnd)
+            Cli_transferReceiveData(sequence,data,length);
+        else if (type == CLI_TRANSFER_END)
+            Cli_transferReceiveEnd(sequence,data,length);
+        return;
+    }
+
+    if ((type == CLI_TRANSFER_END) && Cli_context->transferEnd && (sequence == Cli_context->transferChunks))
+    {
+        Cli_context->transferStatus = CLI_TASKSTATUS_DONE;
+        return;
+    }
+    if ((type != CLI_TRANSFER_ACK) || (length != 1) ||
+        (sequence < Cli_context->transferBase) || (sequence > Cli_context->transferNext))
+        return;
+
+    /*
+     * Only new acknowledged chunks restart the timeout: the receiver
+     * repeats the same acknowledge while it waits.
+     */
+    if ((sequence != Cli_context->transferBase) || (data[0] != Cli_context->transferBitmap))
+    {
+        Cli_context->transferLast = LOCCIONI_CLI_MILLISECONDS();
+        Cli_context->transferRetries = 0;
+    }
+    Cli_context->transferBase = sequence;
+    Cli_context->transferBitmap = data[0];
+
+    /*
+     * A hole before acknowledged chunks is lost: send it again at once,
+     * only once for every position of the window.
+     */
+    if ((data[0] != 0) && (sequence != Cli_context->transferFast))
+    {
+        Cli_context->transferFast = sequence;
+        for (last = 7; (data[0] & (1 << last)) == 0; --last);
+        if (!Cli_transferSendMissing(sequence + last))
+            Cli_transferFail();
+    }
+}
+
+/**
+ * Receive one byte of a packet: a packet with a wrong CRC is dropped, and
+ * the next sync byte is searched.
+ */
+static void Cli_transferReceiveChar (uint8_t c)
+{
+    uint8_t* packet = Cli_context->transferPacket;
+    uint16_t index = Cli_context->transferIndex;
+    uint16_t crc = 0xFFFF;
+    uint16_t i;
+
+    if (index == 0)
+    {
+        if (c == CLI_TRANSFER_SYNC)
+            Cli_context->transferIndex = 1;
+        return;
+    }
+
+    packet[index - 1] = c;
+    Cli_context->transferIndex++;
+
+    /* Type, sequence and length read: check the length. */
+    if ((index == 4) && (packet[3] > LOCCIONI_CLI_TRANSFER_CHUNK))
+    {
+        Cli_context->transferIndex = 0;
+        return;
+    }
+    if ((index < 4) || (index < (4 + packet[3] + 2)))
+        return;
+
+    Cli_context->transferIndex = 0;
+    for (i = 0; i < (4 + packet[3]); ++i)
+        crc = Cli_crc16(crc,packet[i]);
+    if ((packet[4 + packet[3]] != (crc & 0xFF)) || (packet[5 + packet[3]] != (crc >> 8)))
+        return;
+
+    Cli_transferPacket(packet[0],packet[1] | (packet[2] << 8),&packet[4],packet[3]);
+}
+
+static Cli_TaskStatus Cli_transferTask (Cli_Task* task)
+{
+    uint32_t now = LOCCIONI_CLI_MILLISECONDS();
+
+    if (task->abort && (Cli_context->transferStatus == CLI_TASKSTATUS_PENDING))
+        Cli_transferFail();
+
+    if (Cli_context->transferStatus == CLI_TASKSTATUS_PENDING)
+    {
+        if (Cli_context->transferSending)
+        {
+            while ((Cli_context->transferNext < Cli_context->transferChunks) &&
+                   (Cli_context->transferNext < Cli_context->transferBase + LOCCIONI_CLI_TRANSFER_WINDOW))
+            {
+                if (!Cli_transferSendChunk(Cli_context->transferNext++))
+                {
+                    Cli_transferFail();
+                    break;
+                }
+                Cli_context->transferLast = now;
+            }
+            if ((Cli_context->transferBase == Cli_context->transferChunks) && !Cli_context->transferEnd)
+            {
+                Cli_transferSendEnd();
+                Cli_context->transferEnd = TRUE;
+                Cli_context->transferLast = now;
+            }
+        }
+
+        if ((now - Cli_context->transferLast) >= LOCCIONI_CLI_TRANSFER_TIMEOUT)
+        {
+            Cli_context->transferLast = now;
+            /* Committed: two timeouts without END, the sender has the confirmation. */
+            if (!Cli_context->transferSending && Cli_context->transferEnd)
+            {
+                if (++Cli_context->transferRetries >= 2)
+                    Cli_context->transferStatus = CLI_TASKSTATUS_DONE;
+            }
+            else if (++Cli_context->transferRetries > LOCCIONI_CLI_TRANSFER_RETRIES)
+                Cli_transferFail();
+            else if (!Cli_context->transferSending)
+                Cli_transferSendAck();
+            else if (Cli_context->transferEnd)
+                Cli_transferSendEnd();
+            else if (!Cli_transferSendMissing(Cli_context->transferNext))
+                Cli_transferFail();
+        }
+
+        if (Cli_context->transferStatus == CLI_TASKSTATUS_PENDING)
+            return CLI_TASKSTATUS_PENDING;
+    }
+
+    Cli_context->transferMode = FALSE;
+    if (Cli_context->transferStatus == CLI_TASKSTATUS_DONE)
+        Cli_printf("Transfer done, %lu bytes\r\n",(unsigned long)Cli_context->transferSize);
+    return Cli_context->transferStatus;
+}
+
+/**
+ * download <name> and upload <name>: the session switches to binary
+ * packets until the end of the transfer.
+ */
+static void Cli_functionTransfer (void* device, int argc, char* argv[])
+{
+    bool sending = (argv[0][0] == 'd');
+    const Cli_DataEndpoint* endpoint;
+    uint8_t i;
+
+    if (argc == 1)
+    {
+        for (i = 0; i < Cli_dataIndex; ++i)
+        {
+            endpoint = &Cli_dataTable[i];
+            if ((sending ? (void*)endpoint->read : (void*)endpoint->write) != 0)
+                Cli_sendStatusf(endpoint->name,"%lu bytes",(unsigned long)endpoint->size);
+        }
+        return;
+    }
+
+    endpoint = Cli_getData(argv[1]);
+    if ((argc != 2) || (endpoint == 0) ||
+        ((sending ? (void*)endpoint->read : (void*)endpoint->write) == 0))
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    /* The packets follow the command line. */
+    if (!Cli_context->background
+#if LOCCIONI_CLI_FRAMED == 1
+        || Cli_context->framedMode
+#endif
+       )
+    {
+        Cli_sendError("ERR: transfers must be the only command of the line");
+        return;
+    }
+
+    Cli_printf("%s %s, %lu bytes\r\n",sending ? "Sending" : "Receiving",
+               endpoint->name,(unsigned long)endpoint->size);
+
+    Cli_context->transferData    = endpoint;
+    Cli_context->transferSending = sending;
+    Cli_context->transferSize    = sending ? endpoint->size : 0;
+    Cli_context->transferChunks  = (Cli_context->transferSize + LOCCIONI_CLI_TRANSFER_CHUNK - 1) / LOCCIONI_CLI_TRANSFER_CHUNK;
+    Cli_context->transferBase    = 0;
+    Cli_context->transferNext    = 0;
+    Cli_context->transferBitmap  = 0;
+    Cli_context->transferFast    = 0xFFFF;
+    Cli_context->transferEnd     = FALSE;
+    Cli_context->transferRetries = 0;
+    Cli_context->transferIndex   = 0;
+    Cli_context->transferStatus  = CLI_TASKSTATUS_PENDING;
+    Cli_context->transferLast    = LOCCIONI_CLI_MILLISECONDS();
+    Cli_context->transferMode    = TRUE;
+
+    /* The receiver is ready: the first acknowledge starts the upload. */
+    if (!sending)
+        Cli_transferSendAck();
+    Cli_startTask(Cli_transferTask,0,0);
+}
+
+#endif /* LOCCIONI_CLI_TRANSFER */
+
+#if LOCCIONI_CLI_WATCH_LINES > 0
+
+static Cli_TaskStatus Cli_watchTask (Cli_Task* task)
+{
+    uint32_t now = LOCCIONI_CLI_MILLISECONDS();
+
+    if (task->abort)
+    {
+        /* Leave the cursor below the drawn output. */
+        Cli_printf("\x1b[%u;1H",Cli_context->watchLastRow + 1);
+        return CLI_TASKSTATUS_DONE;
+    }
+
+    if ((task->state != 0) && ((now - Cli_context->watchLast) < Cli_context->watchPeriod))
+        return CLI_TASKSTATUS_PENDING;
+    Cli_context->watchLast = now;
+    Cli_context->watchLine = 0;
+    Cli_context->watchChanged = FALSE;
+
+    if (task->state == 0)
+    {
+        /* Clear the screen: the rows are counted from the top. */
+        Cli_printf("\x1b[2J\x1b[HEvery %lu ms: %s, any key to stop\r\n",
+                   (unsigned long)Cli_context->watchPeriod,
+                   Cli_context->watchCommand->name);
+        Cli_context->watchRow = 1;
+        Cli_context->watchState = CLI_WATCH_DRAW;
+        task->state = 1;
+    }
+    else
+    {
+        Cli_context->watchState = CLI_WATCH_REDRAW;
+    }
+
+    Cli_dispatchCommand(Cli_context->watchCommand,
+                        Cli_context->watchNumberOfParams,
+                        Cli_context->watchParams);
+
+    if (Cli_context->watchState == CLI_WATCH_DRAW)
+        Cli_context->watchLastRow = Cli_context->watchRow;
+    Cli_context->watchState = CLI_WATCH_OFF;
+
+    if (Cli_context->watchChanged)
+        Cli_printf("\x1b[%u;1H",Cli_context->watchLastRow + 1);
+    return CLI_TASKSTATUS_PENDING;
+}
+
+static void Cli_functionWatch (void* device, int argc, char* argv[])
+{
+    const Cli_Command* cmd;
+    uint32_t period;
+    char* end;
+    uint8_t length;
+    uint8_t index = 0;
+    uint8_t i;
+
+    if (argc == 1)
+    {
+        Cli_sendHelpString("<ms> <command ...>","Run the command every ms, until a key is pressed");
+        return;
+    }
+    if (argc < 3)
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+
+    period = strtoul(argv[1],&end,10);
+    cmd = Cli_getCommand(argv[2]);
+    if ((*end != '\0') || (period == 0) || (cmd == 0) || (cmd->cmdFunction == Cli_functionWatch))
+    {
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
+    /* It never ends by itself: it can not run inside a batch or a frame. */
+    if (!Cli_context->background)
+    {
+        Cli_sendError("ERR: watch must be the only command of the line");
+        return;
+    }
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    /* The redraw moves the cursor of a terminal. */
+    if (Cli_context->outputFormat != CLI_OUTPUT_TEXT)
+    {
+        Cli_sendError("ERR: watch needs the text output");
+        return;
+    }
+#endif
+
+    /* The line is reused while watch runs: keep a copy of the command. */
+    for (i = 2; i < argc; ++i)
+    {
+        length = strlen(argv[i]) + 1;
+        memcpy(&Cli_context->watchTokens[index],argv[i],length);
+        Cli_context->watchParams[i - 2] = &Cli_context->watchTokens[index];
+        index += length;
+    }
+    Cli_context->watchNumberOfParams = argc - 2;
+    Cli_context->watchCommand = cmd;
+    Cli_context->watchPeriod = period;
+
+    Cli_startTask(Cli_watchTask,0,0);
+}
+
+#endif /* LOCCIONI_CLI_WATCH_LINES */
+
+/**
+ * Execute the line terminated by CR LF that is into Cli_context->buffer.
+ */
+static void Cli_processLine (void)
+{
+    uint8_t count = 0;
+    bool done;
+
+    /* No message, only enter command! */
+    if (Cli_context->bufferIndex == 2)
+    {
+        Cli_context->bufferIndex = 0;
+        Cli_prompt();
+        return;
+    }
+
+    Cli_puts("\r\n");
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    /* The record of a task just ended comes before the one of this line. */
+    Cli_recordEnd();
+    Cli_context->recordPending = TRUE;
+#endif
+
+#if LOCCIONI_CLI_BATCH_SIZE > 0
+    if (Cli_context->batchOpen)
+    {
+        Cli_batchLine(Cli_context->buffer,Cli_context->bufferIndex - 2);
+        Cli_context->bufferIndex = 0;
+        Cli_prompt();
+        return;
+    }
+#endif
+
+    /*
+     * A single command reports its own result, a list one overall, also
+     * when its first command fails.
+     */
+    done = Cli_executeLine(&count,TRUE);
+    if (Cli_context->numberOfCommands > 1)
+        Cli_sendBatchResult(done,count);
+
+    Cli_context->bufferIndex = 0;
+#if LOCCIONI_CLI_EDITOR == 1
+    Cli_context->cursor = 0;
+#endif
+    Cli_lineReset();
+    /* The prompt comes back when the task ends. */
+    if (Cli_context->task.function == 0)
+        Cli_prompt();
+}
+
+#if (LOCCIONI_CLI_COMPLETION == 1) || (LOCCIONI_CLI_HISTORY_SIZE > 0) || (LOCCIONI_CLI_LOG_SIZE > 0)
+/**
+ * Clear the terminal line and write the prompt and the received line again.
+ */
+static void Cli_redrawLine (void)
+{
+    Cli_puts("\r\x1b[2K");
+    Cli_puts(Cli_promptText());
+    Cli_write(Cli_context->buffer,Cli_context->bufferIndex);
+#if LOCCIONI_CLI_EDITOR == 1
+    if (Cli_context->cursor < Cli_context->bufferIndex)
+        Cli_printf("\x1b[%uD",Cli_context->bufferIndex - Cli_context->cursor);
+#endif
+}
+#endif
+
+#if LOCCIONI_CLI_COMPLETION == 1
+
+typedef struct _Cli_Completion
+{
+    const char* prefix;
+    uint8_t length;
+    uint8_t count;
+    const char* first;  /**< First name that matches */
+    uint8_t common;     /**< Length of the prefix shared by the matches */
+    bool list;          /**< Print the matches instead of counting them */
+} Cli_Completion;
+
+static void Cli_completionAdd (Cli_Completion* completion, const char* name)
+{
+    uint8_t i;
+
+    if (strncmp(name,completion->prefix,completion->length) != 0)
+        return;
+
+    if (completion->list)
+    {
+        Cli_puts(name);
+        Cli_puts("  ");
+        return;
+    }
+
+    if (completion->count++ == 0)
+    {
+        completion->first = name;
+        completion->common = strlen(name);
+        return;
+    }
+    for (i = completion->length; (i < completion->common) && (name[i] == completion->first[i]); ++i);
+    completion->common = i;
+}
+
+/**
+ * Add the commands that start with the prefix: into the sorted index they
+ * are contiguous, so the first is searched with a binary search.
+ */
+static void Cli_completeCommand (Cli_Completion* completion)
+{
+    uint8_t low = 0;
+    uint8_t high;
+    uint8_t middle;
+
+#if CLI_DYNAMIC_COMMANDS == 1
+    Cli_indexInit();
+    high = Cli_commandIndexSize;
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        if (strncmp(Cli_commandIndex[middle]->name,completion->prefix,completion->length) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    for (; low < Cli_commandIndexSize; ++low)
+    {
+        if (strncmp(Cli_commandIndex[low]->name,completion->prefix,completion->length) != 0)
+            break;
+        Cli_completionAdd(completion,Cli_commandIndex[low]->name);
+    }
+#else
+    (void)middle;
+    for (high = CLI_COMMAND_TABLE_SIZED; low < high; low++)
+        Cli_completionAdd(completion,Cli_commandTable[low].name);
+#endif
+
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+    for (low = 0; low < CLI_STATIC_COMMAND_TABLE_SIZED; low++)
+        Cli_completionAdd(completion,Cli_staticCommandTable[low].name);
+#endif
+}
+
+static void Cli_completeSubcommand (Cli_Completion* completion, const Cli_Command* cmd)
+{
+    uint8_t i;
+
+    for (i = 0; i < cmd->numberOfSubcommands; ++i)
+    {
+        if (!cmd->subcommands[i].configMode || Cli_context->configMode)
+            Cli_completionAdd(completion,cmd->subcommands[i].name);
+    }
+}
+
+/**
+ * Tab: complete the last word of the line when it is a command name, or
+ * the subcommand of a module. The longest common part of the matches is
+ * added; when nothing can be added the matches are listed.
+ */
+static void Cli_complete (void)
+{
+    const Cli_LineCommand* command = &Cli_context->lineCommands[Cli_context->numberOfCommands];
+    Cli_Completion completion = {0};
+    uint8_t word = command->numberOfParams;
+    uint8_t i;
+
+    if (Cli_context->isParamOpen)
+    {
+        completion.prefix = Cli_context->params[Cli_context->numberOfParams - 1];
+        completion.length = &Cli_context->tokens[Cli_context->tokensIndex] - completion.prefix;
+    }
+    else
+    {
+        completion.prefix = "";
+        word++;
+    }
+
+    if (Cli_context->isStringOpen || Cli_context->lineOverflow || command->wrongParam)
+        word = 0;
+#if LOCCIONI_CLI_EDITOR == 1
+    /* Only the end of the line is completed. */
+    if (Cli_context->cursor != Cli_context->bufferIndex)
+        word = 0;
+#endif
+
+    for (i = 0; i < 2; ++i)
+    {
+        if (word == 1)
+            Cli_completeCommand(&completion);
+        else if ((word == 2) && (command->cmd != 0) && (command->cmd->subcommands != 0))
+            Cli_completeSubcommand(&completion,command->cmd);
+
+        if ((completion.count < 2) || (completion.common > completion.length) || completion.list)
+            break;
+
+        Cli_puts("\r\n");
+        completion.list = TRUE;
+    }
+
+    if (completion.list)
+    {
+        Cli_puts("\r\n");
+        Cli_redrawLine();
+        return;
+    }
+    if (completion.count == 0)
+    {
+        Cli_putChar('\a');
+        return;
+    }
+
+    /* Keep room for CR LF. */
+    for (i = completion.length; i < completion.common; ++i)
+    {
+        if (Cli_context->bufferIndex >= LOCCIONI_CLI_LINE_SIZE - 3)
+            break;
+        Cli_context->buffer[Cli_context->bufferIndex++] = completion.first[i];
+        Cli_lineFeed(completion.first[i]);
+        Cli_putChar(completion.first[i]);
+    }
+    if ((completion.count == 1) && (i == completion.common) &&
+        (Cli_context->bufferIndex < LOCCIONI_CLI_LINE_SIZE - 3))
+    {
+        Cli_context->buffer[Cli_context->bufferIndex++] = ' ';
+        Cli_lineFeed(' ');
+        Cli_putChar(' ');
+    }
+#if LOCCIONI_CLI_EDITOR == 1
+    Cli_context->cursor = Cli_context->bufferIndex;
+#endif
+}
+
+#endif /* LOCCIONI_CLI_COMPLETION */
+
+#if LOCCIONI_CLI_HISTORY_SIZE > 0
+
+static uint16_t Cli_historyPrevious (uint16_t position)
+{
+    return (position == 0) ? (LOCCIONI_CLI_HISTORY_SIZE - 1) : (position - 1);
+}
+
+/**
+ * Find a line of the history: the ring holds the lines one after the
+ * other, each ended by '\0', and the oldest is overwritten.
+ *
+ * @param index 1 for the last line, 2 for the one before and so on
+ * @return FALSE when there are less lines
+ */
+static bool Cli_historyGet (uint8_t index, uint16_t* start, uint8_t* length)
+{
+    uint16_t end = Cli_context->historyHead;
+    uint16_t available = Cli_context->historyLength;
+    uint8_t i;
+
+    for (i = 0; i < index; ++i)
+    {
+        if (available == 0)
+            return FALSE;
+
+        /* Skip the terminator, then go back to the previous one. */
+        *start = Cli_historyPrevious(end);
+        available--;
+        *length = 0;
+        while ((available > 0) && (Cli_context->history[Cli_historyPrevious(*start)] != '\0'))
+        {
+            *start = Cli_historyPrevious(*start);
+            available--;
+            (*length)++;
+        }
+        /* The beginning of the oldest line can have been overwritten. */
+        if ((available == 0) && (Cli_context->historyLength == LOCCIONI_CLI_HISTORY_SIZE))
+            return FALSE;
+        end = *start;
+    }
+    return TRUE;
+}
+
+static void Cli_historyAdd (const char* line, uint8_t length)
+{
+    uint16_t start;
+    uint8_t lastLength;
+    uint8_t i;
+
+    if ((length == 0) || ((length + 1) > LOCCIONI_CLI_HISTORY_SIZE))
+        return;
+
+    /* Do not repeat the last line. */
+    if (Cli_historyGet(1,&start,&lastLength) && (lastLength == length))
+    {
+        for (i = 0; i < length; ++i)
+        {
+            if (Cli_context->history[(start + i) % LOCCIONI_CLI_HISTORY_SIZE] != line[i])
+                break;
+        }
+        if (i == length)
+            return;
+    }
+
+    for (i = 0; i <= length; ++i)
+    {
+        Cli_context->history[Cli_context->historyHead] = (i < length) ? line[i] : '\0';
+        if (++Cli_context->historyHead == LOCCIONI_CLI_HISTORY_SIZE)
+            Cli_context->historyHead = 0;
+    }
+    Cli_context->historyLength += length + 1;
+    if (Cli_context->historyLength > LOCCIONI_CLI_HISTORY_SIZE)
+        Cli_context->historyLength = LOCCIONI_CLI_HISTORY_SIZE;
+}
+
+/**
+ * Replace the received line with a line of the history, 0 for an empty one.
+ */
+static void Cli_historyShow (uint8_t index)
+{
+    uint16_t start;
+    uint8_t length = 0;
+    uint8_t i;
+    char c;
+
+    if ((index > 0) && !Cli_historyGet(index,&start,&length))
+    {
+        Cli_putChar('\a');
+        return;
+    }
+
+    Cli_context->historyIndex = index;
+    Cli_context->bufferIndex = 0;
+    Cli_lineReset();
+    for (i = 0; (i < length) && (i < LOCCIONI_CLI_LINE_SIZE - 3); ++i)
+    {
+        c = Cli_context->history[(start + i) % LOCCIONI_CLI_HISTORY_SIZE];
+        Cli_context->buffer[Cli_context->bufferIndex++] = c;
+        Cli_lineFeed(c);
+    }
+#if LOCCIONI_CLI_EDITOR == 1
+    Cli_context->cursor = Cli_context->bufferIndex;
+#endif
+    Cli_redrawLine();
+}
+
+#endif /* LOCCIONI_CLI_HISTORY_SIZE */
+
+#if LOCCIONI_CLI_EDITOR == 1
+
+/*
+ * Line editor: the line is kept into buffer with the cursor, and every
+ * change sends the shortest update for the terminal, never the whole
+ * line: a char typed at the end is its echo, one typed in the middle
+ * "ESC [ @" and the char, a deleted one "ESC [ P". Short moves send
+ * backspaces or the chars under the cursor instead of a sequence.
+ */
+
+#define CLI_CTRL_A                   0x01
+#define CLI_CTRL_E                   0x05
+#define CLI_CTRL_W                   0x17
+#define CLI_DELETE                   0x7F
+
+static void Cli_editMoveLeft (uint8_t count)
+{
+    if (count == 0)
+        return;
+
+    if (Cli_context->echo)
+    {
+        if (count <= 3)
+            Cli_putFill('\b',count);
+        else
+            Cli_printf("\x1b[%uD",count);
+    }
+    Cli_context->cursor -= count;
+}
+
+static void Cli_editMoveRight (uint8_t count)
+{
+    if (count == 0)
+        return;
+
+    if (Cli_context->echo)
+    {
+        if (count <= 3)
+            Cli_write(&Cli_context->buffer[Cli_context->cursor],count);
+        else
+            Cli_printf("\x1b[%uC",count);
+    }
+    Cli_context->cursor += count;
+}
+
+/**
+ * Delete count chars from the cursor on.
+ */
+static void Cli_editDelete (uint8_t count)
+{
+    uint8_t cursor = Cli_context->cursor;
+
+    if (count == 0)
+        return;
+
+    memmove(&Cli_context->buffer[cursor],
+            &Cli_context->buffer[cursor + count],
+            Cli_context->bufferIndex - cursor - count);
+    Cli_context->bufferIndex -= count;
+    Cli_lineRefeed();
+
+    if (!Cli_context->echo)
+        return;
+
+    if (cursor == Cli_context->bufferIndex)
+        Cli_puts("\x1b[K");
+    else if (count == 1)
+        Cli_puts("\x1b[P");
+    else
+        Cli_printf("\x1b[%uP",count);
+}
+
+static void Cli_editBackspace (void)
+{
+    if (Cli_context->cursor == 0)
+        return;
+
+    if (Cli_context->cursor < Cli_context->bufferIndex)
+    {
+        Cli_editMoveLeft(1);
+        Cli_editDelete(1);
+        return;
+    }
+
+    /* At the end of the line it is the shortest. */
+    if (Cli_context->echo)
+        Cli_puts("\b \b");
+    Cli_context->cursor--;
+    Cli_context->bufferIndex--;
+    Cli_lineRefeed();
+}
+
+/**
+ * Delete the word before the cursor, and the blanks after it.
+ */
+static void Cli_editDeleteWord (void)
+{
+    uint8_t start = Cli_context->cursor;
+
+    while ((start > 0) && (Cli_context->buffer[start - 1] == ' '))
+        start--;
+    while ((start > 0) && (Cli_context->buffer[start - 1] != ' '))
+        start--;
+
+    start = Cli_context->cursor - start;
+    Cli_editMoveLeft(start);
+    Cli_editDelete(start);
+}
+
+static void Cli_editInsert (char c)
+{
+    uint8_t cursor = Cli_context->cursor;
+
+    if (Cli_context->overwrite && (cursor < Cli_context->bufferIndex))
+    {
+        Cli_context->buffer[Cli_context->cursor++] = c;
+        Cli_lineRefeed();
+        if (Cli_context->echo)
+            Cli_putChar(c);
+        return;
+    }
+
+    /* Keep room for CR LF. */
+    if (Cli_context->bufferIndex >= LOCCIONI_CLI_LINE_SIZE - 3)
+    {
+        Cli_context->rxStatistics.discarded++;
+        Cli_putChar('\a');
+        return;
+    }
+
+    if (cursor == Cli_context->bufferIndex)
+    {
+        Cli_context->buffer[Cli_context->bufferIndex++] = c;
+        Cli_lineFeed(c);
+    }
+    else
+    {
+        memmove(&Cli_context->buffer[cursor + 1],
+                &Cli_context->buffer[cursor],
+                Cli_context->bufferIndex - cursor);
+        Cli_context->buffer[cursor] = c;
+        Cli_context->bufferIndex++;
+        Cli_lineRefeed();
+        if (Cli_context->echo)
+            Cli_puts("\x1b[@");
+    }
+    Cli_context->cursor++;
+    if (Cli_context->echo)
+        Cli_putChar(c);
+}
+
+/**
+ * @return TRUE when the line has been ended, with CR LF appended
+ */
+static bool Cli_editChar (char c)
+{
+    bool cr = Cli_context->lastCr;
+
+    Cli_context->lastCr = (c == '\r');
+
+    switch (c)
+    {
+    case '\r':
+    case '\n':
+        /* CR LF is one enter. */
+        if ((c == '\n') && cr)
+            return FALSE;
+        Cli_context->cursor = Cli_context->bufferIndex;
+        Cli_context->buffer[Cli_context->bufferIndex++] = '\r';
+        Cli_context->buffer[Cli_context->bufferIndex++] = '\n';
+        return TRUE;
+
+    case '\b':
+    case CLI_DELETE:
+        Cli_editBackspace();
+        break;
+
+    case CLI_CTRL_A:
+        Cli_editMoveLeft(Cli_context->cursor);
+        break;
+
+    case CLI_CTRL_E:
+        Cli_editMoveRight(Cli_context->bufferIndex - Cli_context->cursor);
+        break;
+
+    case CLI_CTRL_W:
+        Cli_editDeleteWord();
+        break;
+
+    default:
+        /* Other control chars are ignored. */
+        if ((uint8_t)c >= ' ')
+            Cli_editInsert(c);
+        break;
+    }
+    return FALSE;
+}
+
+void Cli_setEcho (bool echo)
+{
+    Cli_context->echo = echo;
+}
+
+#endif /* LOCCIONI_CLI_EDITOR */
+
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+
+static const char* Cli_outputNames[] = {"text", "json", "csv"};
+
+void Cli_setOutputFormat (Cli_OutputFormat format)
+{
+    /* A line that enters JSON or CSV gets an empty record... */
+    bool running = Cli_context->recordPending && (Cli_context->outputFormat == CLI_OUTPUT_TEXT);
+
+    /* ...one that leaves them is answered in the previous format. */
+    Cli_recordEnd();
+
+#if LOCCIONI_CLI_EDITOR == 1
+    /* Programs do not read the echo, and it would end into the records. */
+    if ((Cli_context->outputFormat == CLI_OUTPUT_TEXT) && (format != CLI_OUTPUT_TEXT))
+    {
+        Cli_context->textEcho = Cli_context->echo;
+        Cli_context->echo = FALSE;
+    }
+    else if ((Cli_context->outputFormat != CLI_OUTPUT_TEXT) && (format == CLI_OUTPUT_TEXT))
+    {
+        Cli_context->echo = Cli_context->textEcho;
+    }
+#endif
+    Cli_context->outputFormat = format;
+    Cli_context->recordPending = running;
+}
+
+static void Cli_functionOutput (void* device, int argc, char* argv[])
+{
+    uint8_t i;
+
+    if (argc == 1)
+    {
+        Cli_sendStatusString("output",(char*)Cli_outputNames[Cli_context->outputFormat],0);
+        return;
+    }
+
+    if (argc == 2)
+    {
+        for (i = 0; i < 3; ++i)
+        {
+            if (strcmp(argv[1],Cli_outputNames[i]) == 0)
+            {
+                Cli_setOutputFormat((Cli_OutputFormat)i);
+                return;
+            }
+        }
+    }
+    Cli_sendHelpString("text|json|csv","Output for terminals, JSON lines or CSV rows");
+    LOCCIONI_CLI_WRONGPARAM();
+}
+
+#endif /* LOCCIONI_CLI_OUTPUT_FORMAT */
+
+/**
+ * A whole line has been received: run it, or keep it until the running
+ * task ends.
+ */
+static void Cli_lineEnter (void)
+{
+#if LOCCIONI_CLI_HISTORY_SIZE > 0
+    Cli_historyAdd(Cli_context->buffer,Cli_context->bufferIndex - 2);
+    Cli_context->historyIndex = 0;
+#endif
+    /* Wait for the running task, the line will be executed later. */
+    if (Cli_context->task.function != 0)
+    {
+        Cli_context->linePending = TRUE;
+        return;
+    }
+    Cli_processLine();
+}
+
+/**
+ * Final byte of an escape sequence "ESC [ ..." or "ESC O ...", with its
+ * first numeric parameter.
+ */
+static void Cli_escapeKey (char c)
+{
+    switch (c)
+    {
+#if LOCCIONI_CLI_HISTORY_SIZE > 0
+    case 'A': /* Up */
+        Cli_historyShow(Cli_context->historyIndex + 1);
+        break;
+    case 'B': /* Down */
+        if (Cli_context->historyIndex > 0)
+            Cli_historyShow(Cli_context->historyIndex - 1);
+        break;
+#endif
+#if LOCCIONI_CLI_EDITOR == 1
+    case 'C': /* Right */
+        if (Cli_context->cursor < Cli_context->bufferIndex)
+            Cli_editMoveRight(1);
+        break;
+    case 'D': /* Left */
+        if (Cli_context->cursor > 0)
+            Cli_editMoveLeft(1);
+        break;
+    case 'H': /* Home */
+        Cli_editMoveLeft(Cli_context->cursor);
+        break;
+    case 'F': /* End */
+        Cli_editMoveRight(Cli_context->bufferIndex - Cli_context->cursor);
+        break;
+    case '~':
+        if ((Cli_context->escapeParameter == 1) || (Cli_context->escapeParameter == 7))
+            Cli_editMoveLeft(Cli_context->cursor);
+        else if ((Cli_context->escapeParameter == 4) || (Cli_context->escapeParameter == 8))
+            Cli_editMoveRight(Cli_context->bufferIndex - Cli_context->cursor);
+        else if ((Cli_context->escapeParameter == 3) && (Cli_context->cursor < Cli_context->bufferIndex))
+            Cli_editDelete(1);
+        else if (Cli_context->escapeParameter == 2)
+            Cli_context->overwrite = !Cli_context->overwrite;
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+/**
+ * Keys read while a task runs: Ctrl-C aborts it, and any key stops watch.
+ *
+ * @return TRUE when the key has been used
+ */
+static bool Cli_taskKey (char c)
+{
+    if (Cli_context->task.function == 0)
+        return FALSE;
+
+    if (c == CLI_CTRL_C)
+    {
+        Cli_context->task.abort = TRUE;
+        return TRUE;
+    }
+#if LOCCIONI_CLI_WATCH_LINES > 0
+    /* Any key stops watch. */
+    if (Cli_context->task.function == Cli_watchTask)
+    {
+        Cli_context->task.abort = TRUE;
+        return TRUE;
+    }
+#endif
+    return FALSE;
+}
+
+static void Cli_receiveChar (char c)
+{
+    if (Cli_taskKey(c))
+        return;
+
+    if (Cli_context->escape != 0)
+    {
+        if (Cli_context->escape == 1)
+        {
+            Cli_context->escape = ((c == '[') || (c == 'O')) ? 2 : 0;
+            Cli_context->escapeParameter = 0;
+        }
+        /* Only the first parameter, as the 3 of "ESC [ 3 ~", is kept. */
+        else if ((c >= '0') && (c <= '9'))
+        {
+            if (Cli_context->escape == 2)
+                Cli_context->escapeParameter = Cli_context->escapeParameter * 10 + (c - '0');
+        }
+        else if (c == ';')
+        {
+            Cli_context->escape = 3;
+        }
+        else
+        {
+            Cli_context->escape = 0;
+            Cli_escapeKey(c);
+        }
+        return;
+    }
+    if (c == CLI_ESCAPE)
+    {
+        Cli_context->escape = 1;
+        return;
+    }
+#if LOCCIONI_CLI_COMPLETION == 1
+    if (c == '\t')
+    {
+        Cli_complete();
+        return;
+    }
+#endif
+
+#if LOCCIONI_CLI_EDITOR == 1
+    if (Cli_editChar(c))
+        Cli_lineEnter();
+#else
+    // When buffer is grather then 0, delete one char
+    if ((c == '\b') && (Cli_context->bufferIndex > 0))
+    {
+        Cli_context->bufferIndex--;
+        Cli_lineRefeed();
+        return;
+    }
+    // When no chars into buffer, return to main function
+    else if ((c == '\b') && (Cli_context->bufferIndex == 0))
+    {
+        return;
+    }
+
+    Cli_context->buffer[Cli_context->bufferIndex++] = c;
+    Cli_lineFeed(c);
+
+    if ((Cli_context->bufferIndex >= 2) &&
+        (Cli_context->buffer[Cli_context->bufferIndex-2] == '\r') && (Cli_context->buffer[Cli_context->bufferIndex-1] == '\n'))
+    {
+        Cli_lineEnter();
+    }
+    else if (Cli_context->bufferIndex > LOCCIONI_CLI_LINE_SIZE-1)
+    {
+        Cli_context->rxStatistics.discarded += Cli_context->bufferIndex;
+        Cli_context->bufferIndex = 0;
+        Cli_prompt();
+    }
+#endif
+}
+
+/**
+ * Process received bytes. When a line must wait for the running task, the
+ * bytes that follow it are kept into Cli_context->rxCarry.
+ */
+static void Cli_receive (const char* data, uint16_t length)
+{
+    uint16_t i;
+
+    for (i = 0; i < length; ++i)
+    {
+#if LOCCIONI_CLI_TRANSFER == 1
+        if (Cli_context->transferMode)
+        {
+            Cli_transferReceiveChar((uint8_t)data[i]);
+            continue;
+        }
+#endif
+        /* The line waits for the task: keep what follows, but not its keys. */
+        if (Cli_context->linePending)
+        {
+            if (!Cli_taskKey(data[i]))
+                Cli_context->rxCarry[Cli_context->rxCarryLength++] = data[i];
+            continue;
+        }
+
+#if LOCCIONI_CLI_FRAMED == 1
+        if (Cli_context->framedMode)
+        {
+            Cli_receiveFrameChar((uint8_t)data[i]);
+            continue;
+        }
+#endif
+        Cli_receiveChar(data[i]);
+    }
+}
+
+/**
+ * Read on while a line waits for the running task, so that Ctrl-C can
+ * still stop it: the other bytes are kept into rxCarry, and when it is
+ * full they wait into the transport.
+ */
+static void Cli_receivePending (void)
+{
+    char* carry = Cli_context->rxCarry;
+    uint16_t length;
+    uint16_t start;
+    uint16_t i;
+
+    while ((Cli_context->rxCarryLength < CLI_RX_CHUNK_SIZE) &&
+           (Cli_context->transport->available(Cli_context->transport->handle) > 0))
+    {
+        length = Cli_context->transport->read(Cli_context->transport->handle,
+                                              &carry[Cli_context->rxCarryLength],
+                                              CLI_RX_CHUNK_SIZE - Cli_context->rxCarryLength);
+        if (length == 0)
+            break;
+
+        Cli_context->rxStatistics.received += length;
+        /* Filtered in place: the new bytes follow the kept ones. */
+        start = Cli_context->rxCarryLength;
+        for (i = 0; i < length; ++i)
+        {
+            if (!Cli_taskKey(carry[start + i]))
+                carry[Cli_context->rxCarryLength++] = carry[start + i];
+        }
+    }
+}
+
+/**
+ * Print a message; in framed mode, outside of a reply, it is sent as a
+ * notification frame.
+ */
+static void Cli_putMessage (Cli_MessageType type, const char* who, const char* message)
+{
+#if LOCCIONI_CLI_FRAMED == 1
+    bool notification = Cli_context->framedMode && !Cli_context->frameReplyOpen;
+
+    if (notification)
+        Cli_frameOpen(0,CLI_FRAMEID_MESSAGE);
+#endif
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    if (Cli_isStructured())
+    {
+        Cli_recordMessage(type,who,message);
+        return;
+    }
+#endif
+
+    switch (type)
+    {
+    case CLI_MESSAGETYPE_INFO:
+        Cli_puts("INFO: ");
+        break;
+    case CLI_MESSAGETYPE_WARNING:
+        Cli_puts("WARNING: ");
+        break;
+    case CLI_MESSAGETYPE_ERROR:
+        Cli_puts("ERROR: ");
+        break;
+    }
+
+    Cli_puts(who);
+    Cli_puts("> ");
+    Cli_putsln(message);
+
+#if LOCCIONI_CLI_FRAMED == 1
+    if (notification)
+        Cli_frameClose(CLI_FRAMESTATUS_OK);
+#endif
+}
+
+#if LOCCIONI_CLI_LOG_SIZE > 0
+
+/* With one entry "ready" (position + 1) and "free on the next lap" (position + size) are the same. */
+#if (LOCCIONI_CLI_LOG_SIZE < 2) || ((LOCCIONI_CLI_LOG_SIZE & (LOCCIONI_CLI_LOG_SIZE - 1)) != 0)
+#error "LOCCIONI_CLI_LOG_SIZE must be a power of two, at least 2"
+#endif
+
+#define CLI_LOG_MASK                 (LOCCIONI_CLI_LOG_SIZE - 1)
+
+/**
+ * Queue entry: the sequence tells who owns it. It is stored minus the
+ * entry index, so that the zeroed queue is empty: an entry is free for
+ * the producer of position pos when it is equal to (pos & ~CLI_LOG_MASK),
+ * and ready for the consumer one more than that.
+ */
+typedef struct _Cli_LogEntry
+{
+    volatile uint32_t sequence;
+    Cli_MessageType type;
+    /** Sender and message, separated by '\0'. */
+    char text[LOCCIONI_CLI_LOG_MESSAGE_SIZE];
+} Cli_LogEntry;
+
+typedef struct _Cli_LogSource
+{
+    volatile uint32_t key;       /**< Hash of the sender name, 0 when free */
+    char name[LOCCIONI_CLI_LOG_NAME_SIZE];
+    volatile uint32_t window;    /**< Start of the current second */
+    volatile uint32_t count;     /**< Messages sent into the window */
+    volatile uint32_t limited;   /**< Messages dropped by the rate limit */
+} Cli_LogSource;
+
+static Cli_LogEntry Cli_logQueue[LOCCIONI_CLI_LOG_SIZE];
+/** Next position to reserve, shared by all the producers. */
+static volatile uint32_t Cli_logHead = 0;
+/** Next position to send, used only by Cli_check. */
+static uint32_t Cli_logTail = 0;
+/** Messages dropped because the queue was full. */
+static volatile uint32_t Cli_logDropped = 0;
+
+static Cli_LogSource Cli_logSources[LOCCIONI_CLI_LOG_SOURCES];
+static Cli_MessageType Cli_logLevel = CLI_MESSAGETYPE_INFO;
+static uint32_t Cli_logRate = LOCCIONI_CLI_LOG_RATE;
+
+/**
+ * The only read-modify-write used by the producers. Cortex-M3/M4 (and
+ * host) use exclusive load/store; Cortex-M0+ has none, so there
+ * interrupts are masked for the few instructions of the exchange.
+ */
+static bool Cli_logCompareSwap (volatile uint32_t* value, uint32_t expected, uint32_t desired)
+{
+#if defined (LIBOHIBOARD_KL03Z4)     || \
+    defined (LIBOHIBOARD_FRDMKL03Z)  || \
+    defined (LIBOHIBOARD_KL15Z4)     || \
+    defined (LIBOHIBOARD_KL25Z4)     || \
+    defined (LIBOHIBOARD_FRDMKL25Z)
+    uint32_t primask = __get_PRIMASK();
+    bool done;
+
+    __disable_irq();
+    done = (*value == expected);
+    if (done)
+        *value = desired;
+    __set_PRIMASK(primask);
+    return done;
+#else
+    return __atomic_compare_exchange_n(value,&expected,desired,FALSE,
+                                       __ATOMIC_ACQ_REL,__ATOMIC_RELAXED);
+#endif
+}
+
+static void Cli_logIncrement (volatile uint32_t* value)
+{
+    uint32_t current;
+
+    do
+    {
+        current = *value;
+    }
+    while (!Cli_logCompareSwap(value,current,current + 1));
+}
+
+/**
+ * Apply the rate limit of the sender.
+ *
+ * @return TRUE when the message can be queued
+ */
+static bool Cli_logAllow (const char* who)
+{
+    Cli_LogSource* source;
+    uint32_t key = 2166136261u;
+    uint32_t now;
+    uint8_t i;
+    const char* c;
+
+    if (Cli_logRate == 0)
+        return TRUE;
+
+    /* FNV-1a */
+    for (c = who; *c != '\0'; ++c)
+        key = (key ^ (uint8_t)*c) * 16777619u;
+    if (key == 0)
+        key = 1;
+
+    for (i = 0; i < LOCCIONI_CLI_LOG_SOURCES; ++i)
+    {
+        source = &Cli_logSources[i];
+        if (source->key == key)
+            break;
+
+        if ((source->key == 0) && Cli_logCompareSwap(&source->key,0,key))
+        {
+            strncpy(source->name,who,LOCCIONI_CLI_LOG_NAME_SIZE - 1);
+            break;
+        }
+        /* Taken meanwhile by another sender: it can be this one. */
+        if (source->key == key)
+            break;
+    }
+    /* Too many senders: the others are not limited. */
+    if (i == LOCCIONI_CLI_LOG_SOURCES)
+        return TRUE;
+
+    now = LOCCIONI_CLI_MILLISECONDS();
+    if ((now - source->window) >= 1000)
+    {
+        source->window = now;
+        source->count = 0;
+    }
+    if (source->count >= Cli_logRate)
+    {
+        Cli_logIncrement(&source->limited);
+        return FALSE;
+    }
+    Cli_logIncrement(&source->count);
+    return TRUE;
+}
+
+/**
+ * Copy the message into a free entry, without waiting: when the queue is
+ * full it is dropped.
+ */
+static void Cli_logPush (const char* who, const char* message, Cli_MessageType type)
+{
+    Cli_LogEntry* entry;
+    uint32_t position;
+    uint32_t sequence;
+    uint8_t i = 0;
+
+    if ((type < Cli_logLevel) || !Cli_logAllow(who))
+        return;
+
+    for (;;)
+    {
+        position = Cli_logHead;
+        entry = &Cli_logQueue[position & CLI_LOG_MASK];
+        sequence = __atomic_load_n(&entry->sequence,__ATOMIC_ACQUIRE);
+
+        if (sequence == (position & ~CLI_LOG_MASK))
+        {
+            if (Cli_logCompareSwap(&Cli_logHead,position,position + 1))
+                break;
+        }
+        else if ((int32_t)(sequence - (position & ~CLI_LOG_MASK)) < 0)
+        {
+            /* Not yet sent by Cli_check. */
+            Cli_logIncrement(&Cli_logDropped);
+            return;
+        }
+    }
+
+    entry->type = type;
+    while ((*who != '\0') && (i < LOCCIONI_CLI_LOG_MESSAGE_SIZE - 2))
+        entry->text[i++] = *who++;
+    entry->text[i++] = '\0';
+    while ((*message != '\0') && (i < LOCCIONI_CLI_LOG_MESSAGE_SIZE - 1))
+        entry->text[i++] = *message++;
+    entry->text[i] = '\0';
+
+    __atomic_store_n(&entry->sequence,(position & ~CLI_LOG_MASK) + 1,__ATOMIC_RELEASE);
+}
 
-                for (uint8_t i = 0; i < 4; ++i) Cli_maskAddress[i] = tmp[i];
+/**
+ * Send the queued messages to every open session. The line being typed
+ * is cleared first and written again after the messages.
+ */
+static void Cli_logDrain (void)
+{
+    Cli_Context* previous = Cli_context;
+    Cli_LogEntry* entry = &Cli_logQueue[Cli_logTail & CLI_LOG_MASK];
+    uint8_t i;
 
-                LOCCIONI_CLI_DONECMD();
-                return;
-            }
-            else
-            {
-                LOCCIONI_CLI_WRONGPARAM();
-                return;
-            }
-        }
+    if (__atomic_load_n(&entry->sequence,__ATOMIC_ACQUIRE) != ((Cli_logTail & ~CLI_LOG_MASK) + 1))
+        return;
 
-        if (strcmp(argv[1], "mac") == 0)
+    for (i = 0; i < LOCCIONI_CLI_SESSIONS; ++i)
+    {
+        if (!Cli_sessionOpen[i])
+            continue;
+        Cli_context = &Cli_sessions[i];
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+        if (Cli_context->outputFormat != CLI_OUTPUT_TEXT)
+            continue;
+#endif
+#if LOCCIONI_CLI_FRAMED == 1
+        if (Cli_context->framedMode)
+            continue;
+#endif
+        /* A running task owns the line: the messages go below its progress, sent again after them. */
+        if ((Cli_context->task.function != 0) || Cli_context->linePending)
         {
-            if (Utility_isValidMacAddress(argv[2]))
-            {
-                sscanf(argv[2],
-                       "%d:%d:%d:%d:%d:%d",
-                       &tmp[0],
-                       &tmp[1],
-                       &tmp[2],
-                       &tmp[3],
-                       &tmp[4],
-                       &tmp[5]);
+            if (Cli_context->taskProgress != 0)
+                Cli_puts("\r\n");
+            Cli_context->taskProgress = 0;
+            continue;
+        }
+        Cli_puts("\r\x1b[2K");
+    }
 
-                for (uint8_t i = 0; i < 6; ++i) Cli_macAddress[i] = tmp[i];
+    for (;;)
+    {
+        entry = &Cli_logQueue[Cli_logTail & CLI_LOG_MASK];
+        if (__atomic_load_n(&entry->sequence,__ATOMIC_ACQUIRE) != ((Cli_logTail & ~CLI_LOG_MASK) + 1))
+            break;
 
-                LOCCIONI_CLI_DONECMD();
-                return;
-            }
-            else
-            {
-                LOCCIONI_CLI_WRONGPARAM();
-                return;
-            }
+        for (i = 0; i < LOCCIONI_CLI_SESSIONS; ++i)
+        {
+            if (!Cli_sessionOpen[i])
+                continue;
+            Cli_context = &Cli_sessions[i];
+            Cli_putMessage(entry->type,entry->text,&entry->text[strlen(entry->text) + 1]);
         }
+
+        __atomic_store_n(&entry->sequence,(Cli_logTail & ~CLI_LOG_MASK) + LOCCIONI_CLI_LOG_SIZE,__ATOMIC_RELEASE);
+        Cli_logTail++;
     }
 
-    if (!Cli_configMode)
+    for (i = 0; i < LOCCIONI_CLI_SESSIONS; ++i)
     {
-        Uart_sendString(LOCCIONI_CLI_DEV,Cli_notConfigMode);
-        return;
+        if (!Cli_sessionOpen[i])
+            continue;
+        Cli_context = &Cli_sessions[i];
+#if LOCCIONI_CLI_FRAMED == 1
+        if (Cli_context->framedMode)
+            continue;
+#endif
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+        if (Cli_context->outputFormat != CLI_OUTPUT_TEXT)
+            continue;
+#endif
+        /* A running task prints its own output. */
+        if ((Cli_context->task.function != 0) || Cli_context->linePending)
+            continue;
+        Cli_redrawLine();
     }
 
-    LOCCIONI_CLI_WRONGCMD();
+    Cli_context = previous;
 }
-#endif
 
-static System_Errors (*Cli_saveCallbackFunction)(void) = 0;
+static const char* Cli_logLevelNames[] = {"info", "warning", "error"};
 
-void Cli_saveCallback (System_Errors (*saveCallback)(void))
+void Cli_setLogLevel (Cli_MessageType level)
 {
-    Cli_saveCallbackFunction = saveCallback;
+    Cli_logLevel = level;
 }
 
-static void Cli_saveFlash (void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE])
+static void Cli_functionLog (void* device, int argc, char* argv[])
 {
-    if (argc != 1)
-          return;
+    Cli_LogSource* source;
+    char* end;
+    uint32_t value;
+    uint8_t i;
 
-    if (!Cli_configMode)
+    if ((argc == 2) && (strcmp(argv[1],"reset") == 0))
     {
-        Uart_sendString(LOCCIONI_CLI_DEV,Cli_notConfigMode);
+        Cli_logDropped = 0;
+        for (i = 0; i < LOCCIONI_CLI_LOG_SOURCES; ++i)
+            Cli_logSources[i].limited = 0;
+        LOCCIONI_CLI_DONECMD();
         return;
     }
 
-    Cli_sendString("Saving parameters...");
-    Cli_saveCallbackFunction();
-    Cli_sendString("Reboot necessary!");
-}
+    if ((argc == 3) && (strcmp(argv[1],"level") == 0))
+    {
+        for (i = 0; i < 3; ++i)
+        {
+            if (strcmp(argv[2],Cli_logLevelNames[i]) == 0)
+            {
+                Cli_setLogLevel((Cli_MessageType)i);
+                LOCCIONI_CLI_DONECMD();
+                return;
+            }
+        }
+        LOCCIONI_CLI_WRONGPARAM();
+        return;
+    }
 
-static void Cli_reboot (void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE])
-{
-    if (argc != 1)
-          return;
+    if ((argc == 3) && (strcmp(argv[1],"rate") == 0))
+    {
+        value = strtoul(argv[2],&end,10);
+        if (*end != '\0')
+        {
+            LOCCIONI_CLI_WRONGPARAM();
+            return;
+        }
+        Cli_logRate = value;
+        LOCCIONI_CLI_DONECMD();
+        return;
+    }
 
-    if (!Cli_configMode)
+    if (argc != 1)
     {
-        Uart_sendString(LOCCIONI_CLI_DEV,Cli_notConfigMode);
+        Cli_sendHelpString("level <info|warning|error>","Drop the less severe messages");
+        Cli_sendHelpString("rate <n>","Messages per second of each sender, 0 unlimited");
+        Cli_sendHelpString("reset","Clear the dropped counters");
+        LOCCIONI_CLI_WRONGPARAM();
         return;
     }
 
-    Cli_sendString("Reboot...\r\n");
-    NVIC_SystemReset();
+    Cli_sendStatusf("level","%s",Cli_logLevelNames[Cli_logLevel]);
+    Cli_sendStatusf("rate","%lu/s",(unsigned long)Cli_logRate);
+    Cli_sendStatusf("queued","%lu/%u",(unsigned long)(Cli_logHead - Cli_logTail),LOCCIONI_CLI_LOG_SIZE);
+    Cli_sendStatusf("dropped","%lu",(unsigned long)Cli_logDropped);
+    for (i = 0; i < LOCCIONI_CLI_LOG_SOURCES; ++i)
+    {
+        source = &Cli_logSources[i];
+        if (source->key != 0)
+            Cli_sendStatusf(source->name,"%lu limited",(unsigned long)source->limited);
+    }
 }
 
-static void Cli_parseParams (void)
+#endif /* LOCCIONI_CLI_LOG_SIZE */
+
+void Cli_checkSession (Cli_Context* context)
 {
-    uint8_t i = 0; /* counter for the buffer */
-    uint8_t j = 0; /* counter for each param */
-    bool isStringOpen = FALSE; /* to know if double quote is for open or close */
-    Cli_numberOfParams = 0;
+    Cli_Context* previous = Cli_context;
+    char data[CLI_RX_CHUNK_SIZE];
+    uint16_t length;
+
+    Cli_context = context;
 
+#if LOCCIONI_CLI_TX_BUFFER_SIZE > 0
+    Cli_txDrain(FALSE);
+#endif
 
-    for (i = 0; i < (Cli_bufferIndex -2); ++i)
+    if ((Cli_context->task.function != 0) && Cli_taskStep())
     {
-        if ((Cli_buffer[i] != ' ') && (Cli_buffer[i] != '\"'))
-        {
-            Cli_params[Cli_numberOfParams][j++] = Cli_buffer[i];
-        }
-        else if ((Cli_buffer[i] == '\"') && (isStringOpen == FALSE))
-        {
-            isStringOpen = TRUE;
-        }
-        else if ((Cli_buffer[i] == '\"') && (isStringOpen == TRUE))
-        {
-            isStringOpen = FALSE;
-            Cli_params[Cli_numberOfParams][j] = '\0';
-            j = 0; /* Reset param counter */
-            Cli_numberOfParams++; /* update number of params */
-        }
-        else if ((Cli_buffer[i] == ' ') && (isStringOpen == TRUE))
-        {
-            Cli_params[Cli_numberOfParams][j++] = Cli_buffer[i];
-        }
-        else if (((Cli_buffer[i] == ' ') && (Cli_buffer[i-1] == ' ')) ||
-                 ((Cli_buffer[i] == ' ') && (Cli_buffer[i-1] == '\"')))
+        if (Cli_context->linePending)
         {
-            continue;
+            Cli_context->linePending = FALSE;
+            Cli_processLine();
         }
         else
         {
-            Cli_params[Cli_numberOfParams][j] = '\0';
-            j = 0; /* Reset param counter */
-            Cli_numberOfParams++; /* update number of params */
+            Cli_prompt();
         }
     }
-    Cli_numberOfParams++; /* The last param that can not see! */
+
+    if ((Cli_context->rxCarryLength > 0) && !Cli_context->linePending)
+    {
+        length = Cli_context->rxCarryLength;
+        memcpy(data,Cli_context->rxCarry,length);
+        Cli_context->rxCarryLength = 0;
+        Cli_receive(data,length);
+    }
+
+    /* Drain everything already received, not just one char per call. */
+    while (!Cli_context->linePending && (Cli_context->transport->available(Cli_context->transport->handle) > 0))
+    {
+        length = Cli_context->transport->read(Cli_context->transport->handle,data,sizeof(data));
+        if (length == 0)
+            break;
+
+        Cli_context->rxStatistics.received += length;
+        Cli_receive(data,length);
+    }
+    if (Cli_context->linePending)
+        Cli_receivePending();
+
+#if LOCCIONI_CLI_TX_BUFFER_SIZE > 0
+    Cli_txDrain(FALSE);
+#endif
+
+    Cli_context = previous;
 }
 
 void Cli_check (void)
 {
-    Cli_Command cmd = {NULL, NULL, NULL, NULL};
-    char c;
+    uint8_t i;
 
-    if (Uart_isCharPresent(LOCCIONI_CLI_DEV))
-    {
-    	Uart_getChar(LOCCIONI_CLI_DEV, &c);
-    	// When buffer is grather then 0, delete one char
-    	if ((c == '\b') && (Cli_bufferIndex > 0))
-    	{
-    	    Cli_bufferIndex--;
-    	    return;
-    	}
-    	// When no chars into buffer, return to main function
-    	else if ((c == '\b') && (Cli_bufferIndex == 0))
-    	{
-    	    return;
-    	}
-
-    	Cli_buffer[Cli_bufferIndex++] = c;
-    }
-
-	if ((Cli_bufferIndex != 0) &&
-	    (Cli_buffer[Cli_bufferIndex-2] == '\r') && (Cli_buffer[Cli_bufferIndex-1] == '\n'))
-    {
-		/* No message, only enter command! */
-		if (Cli_bufferIndex == 2)
-		{
-			Cli_bufferIndex = 0;
-	        Cli_prompt();
-	        return;
-		}
-
-		Uart_sendString(LOCCIONI_CLI_DEV, "\r\n");
-		Cli_getCommand(Cli_buffer,&cmd);
-
-		if (cmd.name != NULL)
-		{
-		    Cli_parseParams();
-		    cmd.cmdFunction(cmd.device,Cli_numberOfParams,Cli_params);
-		}
-		else
-		{
-	        Uart_sendString(LOCCIONI_CLI_DEV, "Command not found!");
-		}
-
-		Cli_bufferIndex = 0;
-        Cli_prompt();
-	}
-	else if(Cli_bufferIndex > LOCCIONI_CLI_BUFFER_SIZE-1)
-	{
-	    Cli_bufferIndex = 0;
-		Cli_prompt();
-	}
+#if LOCCIONI_CLI_LOG_SIZE > 0
+    Cli_logDrain();
+#endif
+
+    for (i = 0; i < LOCCIONI_CLI_SESSIONS; ++i)
+    {
+        if (Cli_sessionOpen[i])
+            Cli_checkSession(&Cli_sessions[i]);
+    }
+}
+
+void Cli_getRxStatistics (Cli_RxStatistics* statistics)
+{
+    *statistics = Cli_context->rxStatistics;
+#if LOCCIONI_CLI_RX_INTERRUPT == 1
+    if (Cli_context->transport == &Cli_uartTransport)
+        statistics->overrun += Cli_rxOverrun;
+#endif
+}
+
+void Cli_resetRxStatistics (void)
+{
+    Cli_context->rxStatistics.received  = 0;
+    Cli_context->rxStatistics.overrun   = 0;
+    Cli_context->rxStatistics.discarded = 0;
+#if LOCCIONI_CLI_RX_INTERRUPT == 1
+    if (Cli_context->transport == &Cli_uartTransport)
+        Cli_rxOverrun = 0;
+#endif
 }
 
 void Cli_init (void)
 {
+#ifndef __NO_BOARD_H
     Uart_open (LOCCIONI_CLI_DEV, &Cli_uartConfig);
+    Cli_initTransport(&Cli_uartTransport);
+#else
+    Cli_initTransport(Cli_hostStdioTransport());
+#endif
+}
+
+/**
+ * Bind the session to its transport and greet on it.
+ */
+static void Cli_startSession (Cli_Context* context, const Cli_Transport* transport)
+{
+    Cli_Context* previous = Cli_context;
+
+    Cli_context = context;
+    Cli_context->transport = transport;
+#if LOCCIONI_CLI_EDITOR == 1
+    Cli_context->echo = LOCCIONI_CLI_ECHO;
+#endif
+#if LOCCIONI_CLI_BAUD == 1
+    Cli_context->baudrate = LOCCIONI_CLI_BAUDRATE;
+#endif
 
     Cli_sayHello();
 
-    Uart_sendStringln(LOCCIONI_CLI_DEV, "\r\nCLI ready!");
+#ifdef LOCCIONI_CLI_STATIC_COMMANDS
+    Cli_checkStaticCommand();
+#endif
+
+    Cli_putsln("\r\nCLI ready!");
 
-    Cli_bufferIndex = 0;
     Cli_prompt();
+    Cli_context = previous;
+}
+
+void Cli_initTransport (const Cli_Transport* transport)
+{
+#if defined (CLI_STATISTICS_DWT)
+    /* Start the cycle counter used to time the commands. */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+    Cli_sessionOpen[0] = TRUE;
+    Cli_startSession(&Cli_sessions[0],transport);
+}
+
+Cli_Context* Cli_openSession (const Cli_Transport* transport)
+{
+#if LOCCIONI_CLI_SESSIONS > 1
+    Cli_Context* context;
+    uint8_t i;
+
+    for (i = 1; i < LOCCIONI_CLI_SESSIONS; ++i)
+    {
+        if (!Cli_sessionOpen[i])
+        {
+            context = &Cli_sessions[i];
+            memset(context,0,sizeof(Cli_Context));
+#if LOCCIONI_CLI_TX_BUFFER_SIZE > 0
+            context->txPolicy = LOCCIONI_CLI_TX_POLICY;
+#endif
+            Cli_sessionOpen[i] = TRUE;
+            Cli_startSession(context,transport);
+            return context;
+        }
+    }
+#else
+    (void)transport;
+#endif
+    return 0;
+}
+
+bool Cli_closeSession (Cli_Context* context)
+{
+    uint8_t i;
+
+    /* The first session belongs to Cli_init and is never closed. */
+    for (i = 1; i < LOCCIONI_CLI_SESSIONS; ++i)
+    {
+        if ((context == &Cli_sessions[i]) && Cli_sessionOpen[i])
+            break;
+    }
+    if (i >= LOCCIONI_CLI_SESSIONS)
+        return FALSE;
+
+    Cli_sessionOpen[i] = FALSE;
+    if (Cli_context == context)
+        Cli_context = &Cli_sessions[0];
+    return TRUE;
+}
+
+void Cli_setSession (Cli_Context* context)
+{
+    Cli_context = (context != 0) ? context : &Cli_sessions[0];
+}
+
+Cli_Context* Cli_getSession (void)
+{
+    return Cli_context;
 }
 
 void Cli_setConfigMode (bool config)
 {
-    Cli_configMode = config;
+    Cli_context->configMode = config;
 }
 
 bool Cli_isConfigMode (void)
 {
-    return Cli_configMode;
+    return Cli_context->configMode;
+}
+
+#if CLI_DYNAMIC_COMMANDS == 1
+static void Cli_addToTable (Cli_Command* table,
+                            uint8_t* index,
+                            uint8_t size,
+                            const Cli_Command* cmd)
+{
+    if (*index < size)
+    {
+        table[*index] = *cmd;
+
+        // Duplicated names are discarded
+        Cli_indexInit();
+        if (Cli_indexInsert(&table[*index]))
+            (*index)++;
+    }
+}
+#endif
+
+void Cli_registerModule (char* name,
+                         char* description,
+                         void* device,
+                         Cli_CommandFunction cmdFunction)
+{
+#if CLI_MAX_EXTERNAL_MODULE > 0
+    Cli_Command cmd =
+    {
+        .name        = name,
+        .description = description,
+        .device      = device,
+        .cmdFunction = cmdFunction,
+        .type        = CLI_COMMANDTYPE_MODULE,
+    };
+
+    Cli_addToTable(Cli_externalModuleTable,&Cli_externalModuleIndex,CLI_MAX_EXTERNAL_MODULE,&cmd);
+#endif
+}
+
+void Cli_registerCommand (char* name,
+                          char* description,
+                          Cli_CommandFunction cmdFunction)
+{
+#if CLI_MAX_EXTERNAL_COMMAND > 0
+    Cli_Command cmd =
+    {
+        .name        = name,
+        .description = description,
+        .cmdFunction = cmdFunction,
+        .type        = CLI_COMMANDTYPE_COMMAND,
+    };
+
+    Cli_addToTable(Cli_externalCommandTable,&Cli_externalCommandIndex,CLI_MAX_EXTERNAL_COMMAND,&cmd);
+#endif
+}
+
+#if LOCCIONI_CLI_FRAMED == 1
+void Cli_registerFramedCommand (char* name,
+                                char* description,
+                                void* device,
+                                Cli_CommandFunction cmdFunction,
+                                Cli_FramedFunction framedFunction)
+{
+#if CLI_MAX_EXTERNAL_COMMAND > 0
+    Cli_Command cmd =
+    {
+        .name           = name,
+        .description    = description,
+        .device         = device,
+        .cmdFunction    = cmdFunction,
+        .type           = CLI_COMMANDTYPE_COMMAND,
+        .framedFunction = framedFunction,
+    };
+
+    Cli_addToTable(Cli_externalCommandTable,&Cli_externalCommandIndex,CLI_MAX_EXTERNAL_COMMAND,&cmd);
+#endif
+}
+#endif
+
+void Cli_registerModuleTable (char* name,
+                              char* description,
+                              void* device,
+                              const Cli_Subcommand* subcommands,
+                              uint8_t numberOfSubcommands)
+{
+#if CLI_MAX_EXTERNAL_MODULE > 0
+    Cli_Command cmd =
+    {
+        .name                = name,
+        .description         = description,
+        .device              = device,
+        .type                = CLI_COMMANDTYPE_MODULE,
+        .subcommands         = subcommands,
+        .numberOfSubcommands = numberOfSubcommands,
+    };
+    uint8_t i;
+
+    // The lookup is a binary search
+    for (i = 1; i < numberOfSubcommands; ++i)
+    {
+        if (strcmp(subcommands[i - 1].name,subcommands[i].name) >= 0)
+        {
+            Cli_sendMessage(name,"subcommand table is not sorted",CLI_MESSAGETYPE_WARNING);
+            return;
+        }
+    }
+
+    Cli_addToTable(Cli_externalModuleTable,&Cli_externalModuleIndex,CLI_MAX_EXTERNAL_MODULE,&cmd);
+#endif
+}
+
+#if LOCCIONI_CLI_TYPED_ARGUMENTS == 1
+void Cli_registerTypedCommand (char* name,
+                               char* description,
+                               void* device,
+                               Cli_TypedCommandFunction cmdFunction,
+                               const Cli_Argument* arguments,
+                               uint8_t numberOfArguments)
+{
+#if CLI_MAX_EXTERNAL_COMMAND > 0
+    Cli_Command cmd =
+    {
+        .name              = name,
+        .description       = description,
+        .device            = device,
+        .type              = CLI_COMMANDTYPE_COMMAND,
+        .typedFunction     = cmdFunction,
+        .arguments         = arguments,
+        .numberOfArguments = (numberOfArguments < CLI_MAX_PARAM) ? numberOfArguments : CLI_MAX_PARAM - 1,
+    };
+
+    Cli_addToTable(Cli_externalCommandTable,&Cli_externalCommandIndex,CLI_MAX_EXTERNAL_COMMAND,&cmd);
+#endif
 }
+#endif
+
+#if LOCCIONI_CLI_LEGACY_HANDLER == 1
 
 void Cli_addModule (char* name,
                     char* description,
                     void* device,
-                    void (*cmdFunction)(void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]))
+                    Cli_LegacyCommandFunction cmdFunction)
 {
-    if (Cli_externalModuleIndex < CLI_MAX_EXTERNAL_MODULE)
+#if CLI_MAX_EXTERNAL_MODULE > 0
+    Cli_Command cmd =
     {
-        Cli_externalModuleTable[Cli_externalModuleIndex].name = name;
-        Cli_externalModuleTable[Cli_externalModuleIndex].description = description;
-
-        Cli_externalModuleTable[Cli_externalModuleIndex].device = device;
-        Cli_externalModuleTable[Cli_externalModuleIndex].cmdFunction = cmdFunction;
+        .name           = name,
+        .description    = description,
+        .device         = device,
+        .type           = CLI_COMMANDTYPE_MODULE,
+        .legacyFunction = cmdFunction,
+    };
 
-        Cli_externalModuleIndex++;
-    }
+    Cli_addToTable(Cli_externalModuleTable,&Cli_externalModuleIndex,CLI_MAX_EXTERNAL_MODULE,&cmd);
+#endif
 }
 
 void Cli_addCommand (char* name,
                      char* description,
-                     void (*cmdFunction)(void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]))
+                     Cli_LegacyCommandFunction cmdFunction)
 {
-    if (Cli_externalCommandIndex < CLI_MAX_EXTERNAL_COMMAND)
+#if CLI_MAX_EXTERNAL_COMMAND > 0
+    Cli_Command cmd =
     {
-        Cli_externalCommandTable[Cli_externalCommandIndex].name = name;
-        Cli_externalCommandTable[Cli_externalCommandIndex].description = description;
+        .name           = name,
+        .description    = description,
+        .type           = CLI_COMMANDTYPE_COMMAND,
+        .legacyFunction = cmdFunction,
+    };
+
+    Cli_addToTable(Cli_externalCommandTable,&Cli_externalCommandIndex,CLI_MAX_EXTERNAL_COMMAND,&cmd);
+#endif
+}
 
-        Cli_externalCommandTable[Cli_externalCommandIndex].device = 0;
-        Cli_externalCommandTable[Cli_externalCommandIndex].cmdFunction = cmdFunction;
+#endif /* LOCCIONI_CLI_LEGACY_HANDLER */
 
-        Cli_externalCommandIndex++;
+void Cli_sendHelpString (char* name, char* description)
+{
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    if (Cli_isStructured())
+    {
+        Cli_recordField(name);
+        Cli_puts(description);
+        Cli_recordFieldEnd();
+        return;
     }
+#endif
+    Cli_puts("  "); /* Blank space before command */
+    Cli_putPadded(name,CLI_MAX_CMD_CHAR_LINE - 2);
+    Cli_putChar(';');
+    Cli_putsln(description);
 }
 
-void Cli_sendHelpString (char* name, char* description)
+void Cli_sendStatusString (char* name, char* value, char* other)
 {
-    uint8_t i;
-    uint8_t blank;
+    if (other)
+        Cli_sendStatusf(name,"%s %s",value,other);
+    else
+        Cli_sendStatusf(name,"%s",value);
+}
 
-    blank = CLI_MAX_CMD_CHAR_LINE - strlen(name) - 2;
-    Uart_sendString(LOCCIONI_CLI_DEV,"  "); /* Blank space before command */
-    Uart_sendString(LOCCIONI_CLI_DEV,name);
-    for (i=0; i < blank; ++i) Uart_putChar(LOCCIONI_CLI_DEV,' ');
-    Uart_putChar(LOCCIONI_CLI_DEV,';');
-    Uart_sendStringln(LOCCIONI_CLI_DEV,description);
+static void Cli_vsendStatus (char* name, const char* format, va_list args)
+{
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    if (Cli_isStructured())
+    {
+        Cli_recordField(name);
+        Cli_vprintf(format,args);
+        Cli_recordFieldEnd();
+        return;
+    }
+#endif
+    Cli_putPadded(name,CLI_MAX_CMD_CHAR_LINE);
+    Cli_puts(": ");
+    Cli_vprintf(format,args);
+    Cli_puts("\r\n");
 }
 
-void Cli_sendStatusString (char* name, char* value, char* other)
+#if LOCCIONI_CLI_WATCH_LINES > 0
+/**
+ * Status line of the command run by watch: the first time it is sent and
+ * its row is saved, then it is sent again, moving the cursor on its row,
+ * only when the value changes.
+ */
+static void Cli_watchStatus (char* name, const char* format, va_list args)
 {
-    uint8_t i;
-    uint8_t blank;
+    uint8_t line = Cli_context->watchLine++;
+    va_list copy;
+
+    /* Lines beyond the tracked ones are only drawn the first time. */
+    if (line >= LOCCIONI_CLI_WATCH_LINES)
+    {
+        Cli_vsendStatus(name,format,args);
+        return;
+    }
 
-    blank = CLI_MAX_CMD_CHAR_LINE - strlen(name);
-    Uart_sendString(LOCCIONI_CLI_DEV,name);
-    for (i=0; i < blank; ++i) Uart_putChar(LOCCIONI_CLI_DEV,' ');
-    Uart_putChar(LOCCIONI_CLI_DEV,':');
-    Uart_putChar(LOCCIONI_CLI_DEV,' ');
+    va_copy(copy,args);
+    Cli_context->watchHash = 2166136261u;
+    Cli_context->watchHashing = TRUE;
+    Cli_vprintf(format,copy);
+    Cli_context->watchHashing = FALSE;
+    va_end(copy);
 
-    if (other)
+    if (Cli_context->watchState == CLI_WATCH_DRAW)
     {
-        Uart_sendString(LOCCIONI_CLI_DEV,value);
-        Uart_putChar(LOCCIONI_CLI_DEV,' ');
-        Uart_sendStringln(LOCCIONI_CLI_DEV,other);
+        Cli_context->watchRows[line] = Cli_context->watchRow;
     }
     else
     {
-        Uart_sendStringln(LOCCIONI_CLI_DEV,value);
+        if (Cli_context->watchHash == Cli_context->watchHashes[line])
+            return;
+
+        Cli_context->watchWrite = TRUE;
+        Cli_context->watchChanged = TRUE;
+        Cli_printf("\x1b[%u;1H\x1b[2K",Cli_context->watchRows[line] + 1);
     }
+
+    Cli_context->watchHashes[line] = Cli_context->watchHash;
+    Cli_vsendStatus(name,format,args);
+    Cli_context->watchWrite = FALSE;
 }
+#endif
 
-void Cli_sendString (char* text)
+void Cli_sendStatusf (char* name, const char* format, ...)
 {
-    Uart_sendStringln(LOCCIONI_CLI_DEV,text);
+    va_list args;
+
+    va_start(args,format);
+#if LOCCIONI_CLI_WATCH_LINES > 0
+    if (Cli_context->watchState != CLI_WATCH_OFF)
+        Cli_watchStatus(name,format,args);
+    else
+#endif
+    Cli_vsendStatus(name,format,args);
+    va_end(args);
 }
 
-void Cli_sendMessage (char* who, char* message, Cli_MessageType type)
+void Cli_sendError (char* text)
 {
-    switch (type)
+    Cli_context->commandError = TRUE;
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+    if (Cli_isStructured())
     {
-    case CLI_MESSAGETYPE_INFO:
-        Uart_sendString(LOCCIONI_CLI_DEV,"INFO: ");
-        break;
-    case CLI_MESSAGETYPE_WARNING:
-        Uart_sendString(LOCCIONI_CLI_DEV,"WARNING: ");
-        break;
-    case CLI_MESSAGETYPE_ERROR:
-        Uart_sendString(LOCCIONI_CLI_DEV,"ERROR: ");
-        break;
+        Cli_recordField("error");
+        Cli_puts(text);
+        Cli_recordFieldEnd();
+        return;
     }
+#endif
+    Cli_putsln(text);
+}
+
+void Cli_sendString (char* text)
+{
+    Cli_putsln(text);
+}
 
-    Uart_sendString(LOCCIONI_CLI_DEV,who);
-    Uart_sendString(LOCCIONI_CLI_DEV,"> ");
-    Uart_sendStringln(LOCCIONI_CLI_DEV,message);
+void Cli_sendMessage (char* who, char* message, Cli_MessageType type)
+{
+#if LOCCIONI_CLI_LOG_SIZE > 0
+    Cli_logPush(who,message,type);
+#else
+    Cli_putMessage(type,who,message);
+#endif
 }
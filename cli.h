@@ -33,6 +33,13 @@
  *
  * @li v1.5.0 of 2018/01/xx - Added addCommand function, added network
  * configuration, added save and reboot command, added sendMessage function.
+ * @li v1.6.0 of 2026/10/17 - Added pluggable transport layer and Linux host
+ * backend (__NO_BOARD_H), RX ring buffer and TX queue, multiple sessions,
+ * ';' separated commands, background tasks, typed arguments, subcommand
+ * tables, paged help, Cli_printf and compile-time commands. Added optional
+ * framed protocol, statistics, batch, watch, log queue, line editor, tab
+ * completion, history, baud, download/upload, parameter registry and
+ * JSON/CSV output, all disabled by default.
  *
  * @section library External Library
  *
@@ -54,46 +61,386 @@
  *     #define LOCCIONI_CLI_BAUDRATE   115200
  *
  *     #define LOCCIONI_CLI_ETHERNET   1/0
+ *
+ * On K64F and KV31F the received bytes are stored by the UART interrupt
+ * into a ring buffer of LOCCIONI_CLI_RX_BUFFER_SIZE bytes; define
+ * LOCCIONI_CLI_RX_INTERRUPT to 0 to poll the UART from Cli_check instead.
+ *
+ * Commands can also be declared at compile time, in alphabetical order, so
+ * that they are stored in a const table in flash:
+ *     #define LOCCIONI_CLI_STATIC_COMMANDS(COMMAND, MODULE)              \
+ *         COMMAND("adc", "Read ADC channels", Adc_cliCommand)            \
+ *         MODULE("motor", "Motor control", &Motor_device, Motor_cliModule)
+ * The handlers have the Cli_CommandFunction prototype. Defining
+ * CLI_MAX_EXTERNAL_COMMAND and CLI_MAX_EXTERNAL_MODULE to 0 removes the RAM
+ * tables used by Cli_registerCommand and Cli_registerModule.
  */
 #ifndef __NO_BOARD_H
 #include "board.h"
+#else
+#include "cli-host.h"
 #endif
 
-#define LOCCIONI_CLI_LIBRARY_VERSION     "1.4.0"
+#define LOCCIONI_CLI_LIBRARY_VERSION     "1.6.0"
 #define LOCCIONI_CLI_LIBRARY_VERSION_M   1
-#define LOCCIONI_CLI_LIBRARY_VERSION_m   4
+#define LOCCIONI_CLI_LIBRARY_VERSION_m   6
 #define LOCCIONI_CLI_LIBRARY_VERSION_bug 0
-#define LOCCIONI_CLI_LIBRARY_TIME        1497865040
+#define LOCCIONI_CLI_LIBRARY_TIME        1792195200
 
 /* Public define */
 #ifndef LOCCIONI_CLI_BUFFER_SIZE
 #define LOCCIONI_CLI_BUFFER_SIZE         50
 #endif
+/*
+ * Longest line received, CR LF included. Every session reserves it twice,
+ * for the line and for its tokens, and once more with watch.
+ */
+#ifndef LOCCIONI_CLI_LINE_SIZE
+#define LOCCIONI_CLI_LINE_SIZE           128
+#endif
 
 extern char* Cli_wrongCmd;
 extern char* Cli_wrongParam;
 extern char* Cli_doneCmd;
 
-#define LOCCIONI_CLI_WRONGCMD()           Cli_sendString(Cli_wrongCmd)
-#define LOCCIONI_CLI_WRONGPARAM()         Cli_sendString(Cli_wrongParam)
+#define LOCCIONI_CLI_WRONGCMD()           Cli_sendError(Cli_wrongCmd)
+#define LOCCIONI_CLI_WRONGPARAM()         Cli_sendError(Cli_wrongParam)
 #define LOCCIONI_CLI_DONECMD()            Cli_sendString(Cli_doneCmd)
 
+/**
+ * Byte stream used by the CLI. Every callback receives the handle field as
+ * first parameter.
+ */
+typedef struct _Cli_Transport
+{
+    void* handle;
+
+    /** Read at most length bytes, return the number of bytes read. */
+    uint16_t (*read)(void* handle, char* data, uint16_t length);
+    /** Write at most length bytes, return the number of bytes written. */
+    uint16_t (*write)(void* handle, const char* data, uint16_t length);
+    /** Return the number of bytes that can be read without waiting. */
+    uint16_t (*available)(void* handle);
+    /**
+     * Return the number of bytes that can be written without waiting. It can
+     * be null: in this case the TX queue is drained in small chunks.
+     */
+    uint16_t (*writable)(void* handle);
+    /**
+     * Change the baud rate, used by the "baud" command; it can be null.
+     * With apply FALSE only check that the rate can be generated.
+     */
+    bool (*setBaudrate)(void* handle, uint32_t baudrate, bool apply);
+} Cli_Transport;
+
+/**
+ * Open the default transport (LOCCIONI_CLI_DEV or, when __NO_BOARD_H is
+ * defined, the host standard input/output) and print the welcome banner.
+ */
 void Cli_init (void);
+
+/**
+ * Bind the CLI to a user transport and print the welcome banner.
+ *
+ * @param transport The transport to use, it must remain valid until the
+ *                  next Cli_init call
+ */
+void Cli_initTransport (const Cli_Transport* transport);
+
+/**
+ * Process every byte already received by the transport, executing the
+ * commands completed by CR LF. Every open session is served.
+ */
 void Cli_check (void);
 
+/**
+ * Number of sessions served at the same time, the one of Cli_init
+ * included: for example the debug UART plus some TCP connections.
+ */
+#ifndef LOCCIONI_CLI_SESSIONS
+#define LOCCIONI_CLI_SESSIONS            1
+#endif
+
+/**
+ * State of a session: line, running task, batch, output queue and framed
+ * protocol. The commands are shared by all the sessions.
+ */
+typedef struct _Cli_Context Cli_Context;
+
+/**
+ * Serve another transport and print the welcome banner on it. The first
+ * session is reserved to Cli_init.
+ *
+ * @param transport The transport to use, it must remain valid until the
+ *                  session is closed
+ * @return The session, or null when LOCCIONI_CLI_SESSIONS are already open
+ */
+Cli_Context* Cli_openSession (const Cli_Transport* transport);
+
+/**
+ * Stop serving a session, for example when the connection is lost. A
+ * running task is dropped without calling it again.
+ *
+ * @return FALSE for the first session, or a session that is not open
+ */
+bool Cli_closeSession (Cli_Context* context);
+
+/**
+ * Serve a single session, like Cli_check does for all of them.
+ */
+void Cli_checkSession (Cli_Context* context);
+
+/**
+ * The output functions, as the statistics, policy and mode functions, act
+ * on the current session: the one that runs the command inside Cli_check,
+ * otherwise the one selected with Cli_setSession (by default the first).
+ *
+ * @param context The session, null for the one of Cli_init
+ */
+void Cli_setSession (Cli_Context* context);
+Cli_Context* Cli_getSession (void);
+
+typedef struct _Cli_RxStatistics
+{
+    uint32_t received;  /**< Bytes processed by Cli_check */
+    uint32_t overrun;   /**< Bytes dropped because the RX ring buffer was full */
+    uint32_t discarded; /**< Bytes dropped because the line was too long */
+} Cli_RxStatistics;
+
+void Cli_getRxStatistics (Cli_RxStatistics* statistics);
+void Cli_resetRxStatistics (void);
+
+/**
+ * Behaviour of the output functions when the TX queue
+ * (LOCCIONI_CLI_TX_BUFFER_SIZE bytes) is full.
+ */
+typedef enum
+{
+    CLI_TXPOLICY_BLOCK,    /**< Wait until the transport makes room */
+    CLI_TXPOLICY_DROP,     /**< Discard the data that does not fit */
+    CLI_TXPOLICY_TRUNCATE, /**< Discard and append LOCCIONI_CLI_TX_MARKER */
+} Cli_TxPolicy;
+
+typedef struct _Cli_TxStatistics
+{
+    uint32_t sent;      /**< Bytes written to the transport */
+    uint32_t dropped;   /**< Bytes discarded because the queue was full */
+    uint16_t highWater; /**< Maximum number of bytes queued */
+    uint16_t pending;   /**< Bytes currently queued */
+} Cli_TxStatistics;
+
+void Cli_setTxPolicy (Cli_TxPolicy policy);
+void Cli_getTxStatistics (Cli_TxStatistics* statistics);
+void Cli_resetTxStatistics (void);
+
+/**
+ * Wait until every queued byte has been written to the transport.
+ */
+void Cli_flush (void);
+
+/**
+ * Command handler: argv[0] is the command name and every argv[i] points
+ * directly into the CLI line buffer, so it is valid only until the handler
+ * returns. Modules are also called with argc equal to 1 and argv null to
+ * print their help.
+ */
+typedef void (*Cli_CommandFunction)(void* device, int argc, char* argv[]);
+
+void Cli_registerModule (char* name,
+                         char* description,
+                         void* device,
+                         Cli_CommandFunction cmdFunction);
+
+void Cli_registerCommand (char* name,
+                          char* description,
+                          Cli_CommandFunction cmdFunction);
+
+/**
+ * Subcommand of a module: the handler receives argv[0] equal to the
+ * subcommand name.
+ */
+typedef struct _Cli_Subcommand
+{
+    const char* name;
+    const char* arguments;   /**< Shown by help after the name, can be null */
+    const char* description;
+    bool configMode;         /**< Refused outside of configuration mode */
+    Cli_CommandFunction cmdFunction;
+} Cli_Subcommand;
+
+/**
+ * Register a module whose subcommands are in a const table sorted by name:
+ * the CLI looks the subcommand up, checks the configuration mode and
+ * prints the help from the table. An unsorted table is refused with a
+ * warning message.
+ */
+void Cli_registerModuleTable (char* name,
+                              char* description,
+                              void* device,
+                              const Cli_Subcommand* subcommands,
+                              uint8_t numberOfSubcommands);
+
+#ifndef LOCCIONI_CLI_LEGACY_HANDLER
+#define LOCCIONI_CLI_LEGACY_HANDLER      1
+#endif
+
+#if LOCCIONI_CLI_LEGACY_HANDLER == 1
+/**
+ * Handler with the parameters copied into a two dimensional array, kept
+ * for the modules written before Cli_registerCommand: prefer the latter,
+ * that does not copy the line.
+ */
+typedef void (*Cli_LegacyCommandFunction)(void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]);
+
 void Cli_addModule (char* name,
                     char* description,
                     void* device,
-                    void (*cmdFunction)(void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]));
+                    Cli_LegacyCommandFunction cmdFunction);
 
 void Cli_addCommand (char* name,
                      char* description,
-                     void (*cmdFunction)(void* device, int argc, char argv[][LOCCIONI_CLI_BUFFER_SIZE]));
+                     Cli_LegacyCommandFunction cmdFunction);
+#endif
+
+#ifndef LOCCIONI_CLI_TYPED_ARGUMENTS
+#define LOCCIONI_CLI_TYPED_ARGUMENTS     1
+#endif
+
+#if LOCCIONI_CLI_TYPED_ARGUMENTS == 1
+typedef enum
+{
+    CLI_ARGTYPE_INT,     /**< Decimal, or hexadecimal with 0x */
+    CLI_ARGTYPE_HEX,     /**< Hexadecimal up to 32 bits, 0x optional */
+    CLI_ARGTYPE_FLOAT,   /**< Decimal with optional fraction, no exponent */
+    CLI_ARGTYPE_IPV4,    /**< x.x.x.x */
+    CLI_ARGTYPE_MAC,     /**< yy:yy:yy:yy:yy:yy, hexadecimal */
+    CLI_ARGTYPE_KEYWORD, /**< One of keywords, the value is its index */
+    CLI_ARGTYPE_STRING,
+} Cli_ArgumentType;
+
+/**
+ * Schema of one argument. INT, HEX and FLOAT are checked against
+ * [min, max] when min < max.
+ */
+typedef struct _Cli_Argument
+{
+    const char* name;
+    Cli_ArgumentType type;
+    int32_t min;
+    int32_t max;
+    const char* const* keywords; /**< Null terminated, for KEYWORD */
+    bool optional;               /**< It and the following can be omitted */
+} Cli_Argument;
+
+typedef union _Cli_Value
+{
+    int32_t integer;     /**< INT, HEX (all the 32 bits) and KEYWORD */
+    float real;
+    uint8_t ip[4];
+    uint8_t mac[6];
+    const char* string;  /**< Valid until the handler returns */
+} Cli_Value;
+
+/**
+ * Handler of a command with an argument schema: the CLI has already
+ * checked and converted the arguments, argv[0] is the first one (not the
+ * command name) and argc is the number of arguments given.
+ */
+typedef void (*Cli_TypedCommandFunction)(void* device, int argc, const Cli_Value* argv);
+
+/**
+ * Register a command whose arguments are validated and converted by the
+ * CLI: wrong arguments are reported with the expected type and the usage,
+ * and help lists the arguments.
+ */
+void Cli_registerTypedCommand (char* name,
+                               char* description,
+                               void* device,
+                               Cli_TypedCommandFunction cmdFunction,
+                               const Cli_Argument* arguments,
+                               uint8_t numberOfArguments);
+#endif
+
+/**
+ * Per command statistics, shown by the "stats" command: calls, execution
+ * time and bytes sent. The time is measured with
+ * LOCCIONI_CLI_STATISTICS_CLOCK(), by default the DWT cycle counter on
+ * Cortex-M4 and a nanoseconds clock on host; elsewhere only calls and
+ * bytes are counted unless the clock is defined.
+ */
+#ifndef LOCCIONI_CLI_STATISTICS
+#define LOCCIONI_CLI_STATISTICS          0
+#endif
+
+#ifndef LOCCIONI_CLI_FRAMED
+#define LOCCIONI_CLI_FRAMED              0
+#endif
+
+#if LOCCIONI_CLI_FRAMED == 1
+/**
+ * Framed protocol, entered with the "framed" command. Every frame is SLIP
+ * encoded and contains:
+ *     request: sequence (1) | command id (1) | arguments (n) | CRC16 (2)
+ *     reply:   sequence (1) | command id (1) | data (n) | status (1) | CRC16 (2)
+ * The CRC16-CCITT (initial value 0xFFFF) covers every previous byte and is
+ * sent little endian. Commands without a framed handler receive the
+ * arguments as null separated strings, and their text output is returned
+ * as reply data.
+ */
+#define CLI_FRAMEID_MESSAGE              0xFD /**< Cli_sendMessage notification */
+#define CLI_FRAMEID_EXIT                 0xFE /**< Back to the text protocol */
+#define CLI_FRAMEID_LOOKUP               0xFF /**< Command name to command id */
+
+#define CLI_FRAMESTATUS_OK               0x00
+#define CLI_FRAMESTATUS_UNKNOWN          0x01
+#define CLI_FRAMESTATUS_PARAM            0x02
+#define CLI_FRAMESTATUS_CRC              0x03
+#define CLI_FRAMESTATUS_OVERFLOW         0x04
+#define CLI_FRAMESTATUS_FAILED           0x05 /**< The handler called Cli_sendError */
+
+/**
+ * Binary handler: it writes its reply with Cli_sendData and returns one of
+ * the CLI_FRAMESTATUS values (or a user value from 0x80).
+ */
+typedef uint8_t (*Cli_FramedFunction)(void* device, const uint8_t* data, uint16_t length);
+
+void Cli_registerFramedCommand (char* name,
+                                char* description,
+                                void* device,
+                                Cli_CommandFunction cmdFunction,
+                                Cli_FramedFunction framedFunction);
+
+void Cli_sendData (const void* data, uint16_t length);
+bool Cli_isFramedMode (void);
+#endif
 
 void Cli_sendHelpString (char* name, char* description);
 void Cli_sendStatusString (char* name, char* value, char* other);
+
+/**
+ * Small formatter that writes straight to the CLI output, without sprintf
+ * and without a line buffer. Conversions, with the optional flags '-' and
+ * '0', width (also '*') and 'l' modifier:
+ *  - %d %i %u %x %X %c %s %% as printf;
+ *  - %.Nq an integer printed as fixed point with N decimals, so
+ *    ("%.2q",1234) prints 12.34;
+ *  - %I a uint8_t[4] IPv4 address, %M a uint8_t[6] MAC address.
+ */
+void Cli_printf (const char* format, ...);
+
+/**
+ * Like Cli_sendStatusString, with the value formatted by Cli_printf.
+ */
+void Cli_sendStatusf (char* name, const char* format, ...);
 void Cli_sendString (char* text);
 
+/**
+ * Send an error line and mark the running command as failed: a batch
+ * (commands separated by ';' or between "batch begin" and "batch end")
+ * stops at the first failed command.
+ */
+void Cli_sendError (char* text);
+
 typedef enum
 {
     CLI_MESSAGETYPE_INFO,
@@ -102,23 +449,290 @@ typedef enum
 } Cli_MessageType;
 
 /**
+ * Number of messages queued by Cli_sendMessage, a power of two and at
+ * least 2; 0 sends them at once, as before. Each entry takes
+ * LOCCIONI_CLI_LOG_MESSAGE_SIZE + 8 bytes and each sender
+ * LOCCIONI_CLI_LOG_NAME_SIZE + 16: about 800 bytes with 8 entries and the
+ * default sizes.
+ */
+#ifndef LOCCIONI_CLI_LOG_SIZE
+#define LOCCIONI_CLI_LOG_SIZE            0
+#endif
+
+/**
+ * With LOCCIONI_CLI_LOG_SIZE > 0 the message is copied into a lock-free
+ * queue, so it can be called from interrupts too, and Cli_check sends it
+ * to every session, redrawing the line being typed. Messages below the
+ * log level, over the rate limit of the sender or with the queue full
+ * are dropped and counted: see the "log" command.
+ *
  * @param who String that contain the name of message sender
  * @param message String that contains the message
  * @param type The type of the message: INFO, WARNING or ERROR
  */
 void Cli_sendMessage (char* who, char* message, Cli_MessageType type);
 
+#if LOCCIONI_CLI_LOG_SIZE > 0
+/**
+ * Drop the messages less severe than level.
+ */
+void Cli_setLogLevel (Cli_MessageType level);
+#endif
+
+/**
+ * Output for programs, chosen for every session with the "output" command:
+ * in JSON and CSV the status, help and error helpers write fields without
+ * padding, and the prompt is not sent. Every line gets one record when it
+ * ends, also an empty one; the other text of the line is its "text" field.
+ *  - JSON: one object per line, {"name":"value",...}; messages are objects
+ *    with "type", "from" and "message".
+ *  - CSV: a "name","value" row for every field and an empty row at the end
+ *    of the line; messages are "type","from","message" rows.
+ * The state of a session takes 8 bytes of RAM.
+ */
+#ifndef LOCCIONI_CLI_OUTPUT_FORMAT
+#define LOCCIONI_CLI_OUTPUT_FORMAT       0
+#endif
+
+#if LOCCIONI_CLI_OUTPUT_FORMAT == 1
+typedef enum
+{
+    CLI_OUTPUT_TEXT,
+    CLI_OUTPUT_JSON,
+    CLI_OUTPUT_CSV,
+} Cli_OutputFormat;
+
+/**
+ * Change the output of the current session.
+ */
+void Cli_setOutputFormat (Cli_OutputFormat format);
+#endif
+
+typedef enum
+{
+    CLI_TASKSTATUS_DONE,
+    CLI_TASKSTATUS_PENDING,
+    CLI_TASKSTATUS_FAILED,
+} Cli_TaskStatus;
+
+struct _Cli_Task;
+typedef Cli_TaskStatus (*Cli_TaskFunction)(struct _Cli_Task* task);
+
+/**
+ * Long running command: the function is called once for every Cli_check
+ * until it returns CLI_TASKSTATUS_DONE or CLI_TASKSTATUS_FAILED, so the
+ * main loop is never blocked for the whole operation.
+ */
+typedef struct _Cli_Task
+{
+    Cli_TaskFunction function;
+    void* device;
+    void* context;
+
+    uint32_t state;   /**< Free for the task, 0 at the first call */
+    uint8_t progress; /**< Percentage set by the task, sent when it changes */
+    bool abort;       /**< Set by Ctrl-C: this is the last call, DONE ends it quietly */
+} Cli_Task;
+
+/**
+ * Called by a command handler to go on in the background. The prompt comes
+ * back when the task ends; inside a batch or in framed mode the task is
+ * run to the end before the next command.
+ *
+ * @return FALSE when another task is running
+ */
+bool Cli_startTask (Cli_TaskFunction function, void* device, void* context);
+bool Cli_isTaskRunning (void);
+
 /**
  *
  * @param saveCallback User callback to save data into memory
  */
 void Cli_saveCallback (System_Errors (*saveCallback)(void));
 
+/**
+ * Like Cli_saveCallback, but the save command runs the task in the
+ * background instead of blocking until the memory is written.
+ *
+ * @param saveTask User task to save data into memory
+ */
+void Cli_saveTask (Cli_TaskFunction saveTask);
+
 #if LOCCIONI_CLI_ETHERNET == 1
+/**
+ * With LOCCIONI_CLI_PARAMETERS the addresses are also registered as the
+ * parameters net.ip, net.mask, net.gw and net.mac.
+ */
 void Cli_setNetworkMemoryArray (uint8_t* ip, uint8_t* mask, uint8_t* gw, uint8_t* mac);
 #endif
 
+/**
+ * Parameter registry: "param list", "param get <name>" and, in
+ * configuration mode, "param set <name> <value>". The values are checked
+ * with the Cli_Argument schema of each parameter. "save" appends only
+ * the parameters changed since the last save to a log into the storage;
+ * when the log is full the current values are rewritten into the other
+ * bank ("param compact" does it on demand). The table takes 12 bytes for
+ * each of the LOCCIONI_CLI_PARAMETERS_MAX parameters, plus about 60 bytes
+ * of statistics and state.
+ */
+#ifndef LOCCIONI_CLI_PARAMETERS
+#define LOCCIONI_CLI_PARAMETERS          0
+#endif
+
+#if LOCCIONI_CLI_PARAMETERS == 1
+#if LOCCIONI_CLI_TYPED_ARGUMENTS != 1
+#error "LOCCIONI_CLI_PARAMETERS needs LOCCIONI_CLI_TYPED_ARGUMENTS"
+#endif
+
+/**
+ * Two banks of size bytes each, like two flash sectors: bank b starts at
+ * address b * size. Erased bytes read 0xFF and are written only once
+ * before the next erase.
+ */
+typedef struct _Cli_Storage
+{
+    void* handle;
+    uint32_t size;
+
+    bool (*read)(void* handle, uint32_t address, void* data, uint16_t length);
+    bool (*write)(void* handle, uint32_t address, const void* data, uint16_t length);
+    bool (*erase)(void* handle, uint8_t bank);
+} Cli_Storage;
+
+/**
+ * Register a variable as parameter, with the name, type and range of
+ * argument. The size of value is 1, 2 or 4 bytes for INT (signed, unless
+ * the range is not negative) and HEX, 1 for KEYWORD, 4 for FLOAT and IPV4,
+ * 6 for MAC and the array size for STRING.
+ *
+ * @return FALSE when the name is already used, the size is wrong or the
+ *         registry is full
+ */
+bool Cli_registerParameter (const Cli_Argument* argument, void* value, uint8_t size);
+
+/**
+ * Read the values saved into storage, after the parameters have been
+ * registered: a parameter never saved keeps its value.
+ *
+ * @param storage The storage to use, it must remain valid
+ * @return FALSE when the storage holds no valid bank
+ */
+bool Cli_loadParameters (const Cli_Storage* storage);
+
+/**
+ * Mark the parameter whose variable is value as changed, when the
+ * program writes it directly.
+ */
+void Cli_setParameterChanged (const void* value);
+
+/**
+ * Write the changed parameters, as the "save" command.
+ */
+bool Cli_saveParameters (void);
+#endif
+
 void Cli_setConfigMode (bool config);
 bool Cli_isConfigMode (void);
 
+/**
+ * Line editor: the CLI echoes the received chars and handles left/right,
+ * home/end (also Ctrl-A/Ctrl-E), delete, Ctrl-W to delete a word and
+ * insert to switch to overwrite. A line ends with CR, LF or CR LF.
+ * Off, as by default, the terminal keeps its local echo and only the final
+ * backspace can be used. It takes 4 bytes of RAM for each session.
+ */
+#ifndef LOCCIONI_CLI_EDITOR
+#define LOCCIONI_CLI_EDITOR              0
+#endif
+
+#if LOCCIONI_CLI_EDITOR == 1
+/** Echo of new sessions, turn it off for programs that do not read it. */
+#ifndef LOCCIONI_CLI_ECHO
+#define LOCCIONI_CLI_ECHO                TRUE
+#endif
+
+/**
+ * Enable or disable the echo of the current session.
+ */
+void Cli_setEcho (bool echo);
+#endif
+
+/**
+ * The "download" and "upload" commands move a registered block of data,
+ * for example a log or a firmware image, over the session with sliding
+ * window packets. The host side is Cli_hostDownload/Cli_hostUpload.
+ * Every session keeps a packet, LOCCIONI_CLI_TRANSFER_CHUNK + 6 bytes, and
+ * about 40 bytes of state; every registered block 20 bytes.
+ */
+#ifndef LOCCIONI_CLI_TRANSFER
+#define LOCCIONI_CLI_TRANSFER            0
+#endif
+
+#if LOCCIONI_CLI_TRANSFER == 1
+/** Data bytes of a packet, at most 255. */
+#ifndef LOCCIONI_CLI_TRANSFER_CHUNK
+#define LOCCIONI_CLI_TRANSFER_CHUNK      64
+#endif
+/** Packets sent before an acknowledgement, at most 8. */
+#ifndef LOCCIONI_CLI_TRANSFER_WINDOW
+#define LOCCIONI_CLI_TRANSFER_WINDOW     8
+#endif
+/** Milliseconds without an answer before sending again. */
+#ifndef LOCCIONI_CLI_TRANSFER_TIMEOUT
+#define LOCCIONI_CLI_TRANSFER_TIMEOUT    500
+#endif
+#ifndef LOCCIONI_CLI_TRANSFER_RETRIES
+#define LOCCIONI_CLI_TRANSFER_RETRIES    10
+#endif
+
+/* Checked here, so that cli-host.c builds its packets with the same limits. */
+#if (LOCCIONI_CLI_TRANSFER_CHUNK < 1) || (LOCCIONI_CLI_TRANSFER_CHUNK > 255)
+#error "LOCCIONI_CLI_TRANSFER_CHUNK must fit the 8 bit packet length"
+#endif
+#if (LOCCIONI_CLI_TRANSFER_WINDOW < 1) || (LOCCIONI_CLI_TRANSFER_WINDOW > 8)
+#error "LOCCIONI_CLI_TRANSFER_WINDOW must fit the 8 bit acknowledge bitmap"
+#endif
+
+/*
+ * Packets of the "download" and "upload" commands: sync, type, sequence
+ * (16 bit), length, data and the CRC16-CCITT from type to data, all
+ * little endian. The receiver acknowledges the first chunk it misses with
+ * a bitmap of the following ones it has, so the sender sends again only
+ * the missing chunks.
+ */
+#define CLI_TRANSFER_SYNC                0xA5
+#define CLI_TRANSFER_DATA                'D'  /**< Chunk number, data */
+#define CLI_TRANSFER_ACK                 'A'  /**< First chunk missing, bitmap of the next ones */
+#define CLI_TRANSFER_END                 'E'  /**< Number of chunks, size (32 bit); echoed back */
+#define CLI_TRANSFER_ABORT               'X'
+
+/** Sequence numbers are 16 bit, and 0xFFFF is never a chunk. */
+#define CLI_TRANSFER_MAX_SIZE            (0xFFFEul * LOCCIONI_CLI_TRANSFER_CHUNK)
+
+/**
+ * Data source of "download": copy length bytes from offset, return the
+ * bytes copied.
+ */
+typedef uint16_t (*Cli_DataRead)(void* device, uint32_t offset, uint8_t* data, uint16_t length);
+
+/**
+ * Data sink of "upload": chunks can come in any order. At the end it is
+ * called with length 0 and offset equal to the total size, to commit.
+ */
+typedef bool (*Cli_DataWrite)(void* device, uint32_t offset, const uint8_t* data, uint16_t length);
+
+/**
+ * Register a named block of data for "download" (read not null) and
+ * "upload" (write not null, at most size bytes).
+ *
+ * @return FALSE when the table is full or size exceeds CLI_TRANSFER_MAX_SIZE
+ */
+bool Cli_registerData (char* name,
+                       void* device,
+                       uint32_t size,
+                       Cli_DataRead read,
+                       Cli_DataWrite write);
+#endif
+
 #endif /* __CLI_LOCCIONI_H */
@@ -0,0 +1,136 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*
+ * Lines with ';' separated commands and "batch" blocks: the commands run in
+ * order and stop at the first failure, and a single summary is sent for
+ * the whole list.
+ */
+
+#include "cli.h"
+#include "cli-test.h"
+
+static char Test_log[64];
+
+static void Test_add (void* device, int argc, char* argv[])
+{
+    (void)device;
+    if ((argc == 2) && ((strlen(Test_log) + strlen(argv[1])) < sizeof(Test_log)))
+        strcat(Test_log,argv[1]);
+}
+
+static void Test_fail (void* device, int argc, char* argv[])
+{
+    (void)device;
+    (void)argc;
+    (void)argv;
+    Cli_sendError("ERR: failed on purpose");
+}
+
+static const char* Test_line (const char* line)
+{
+    Test_log[0] = '\0';
+    return Test_send(line);
+}
+
+int main (void)
+{
+    const char* output;
+
+    Cli_registerCommand("add","Append the parameter to the log",Test_add);
+    Cli_registerCommand("fail","Always fail",Test_fail);
+    Test_open();
+
+    output = Test_line("add a; add b ;add c\r\n");
+    TEST_CHECK(strcmp(Test_log,"abc") == 0);
+    TEST_CHECK(strstr(output,"Batch done: 3") != 0);
+
+    output = Test_line("add d; fail; add e\r\n");
+    TEST_CHECK(strcmp(Test_log,"d") == 0);
+    TEST_CHECK(strstr(output,"ERR: Batch stopped at command 2") != 0);
+
+    output = Test_line("add \"f;g\"; add h;\r\n");
+    TEST_CHECK(strcmp(Test_log,"f;gh") == 0);
+    TEST_CHECK(strstr(output,"Batch done: 2") != 0);
+
+    /* A single command reports its own result only. */
+    output = Test_line("add i\r\n");
+    TEST_CHECK(strcmp(Test_log,"i") == 0);
+    TEST_CHECK(strstr(output,"Batch") == 0);
+
+    output = Test_line("nothing; add j\r\n");
+    TEST_CHECK(Test_log[0] == '\0');
+    TEST_CHECK(strstr(output,"ERR: Batch stopped at command 1") != 0);
+
+    /* The lines of a batch run only at "batch end". */
+    Test_line("batch begin\r\n");
+    Test_send("add 1\r\n");
+    Test_send("add 2; add 3\r\n");
+    TEST_CHECK(Test_log[0] == '\0');
+    output = Test_send("batch end\r\n");
+    TEST_CHECK(strcmp(Test_log,"123") == 0);
+    TEST_CHECK(strstr(output,"Batch done: 3") != 0);
+
+    Test_line("batch begin\r\n");
+    Test_send("add 4\r\n");
+    Test_send("fail\r\n");
+    Test_send("add 5\r\n");
+    output = Test_send("batch end\r\n");
+    TEST_CHECK(strcmp(Test_log,"4") == 0);
+    TEST_CHECK(strstr(output,"ERR: Batch stopped at command 2") != 0);
+
+    Test_line("batch begin\r\n");
+    Test_send("add 6\r\n");
+    Test_send("batch abort\r\n");
+    Test_send("batch end\r\n");
+    TEST_CHECK(Test_log[0] == '\0');
+
+    /* The terminators are matched as tokens, like any command. */
+    Test_line("batch begin\r\n");
+    Test_send("add 9\r\n");
+    output = Test_send("  batch   end \r\n");
+    TEST_CHECK(strcmp(Test_log,"9") == 0);
+    TEST_CHECK(strstr(output,"Batch done: 1") != 0);
+
+    Test_line("batch begin\r\n");
+    Test_send("add 10\r\n");
+    Test_send("batch \"abort\" \r\n");
+    output = Test_send("batch end\r\n");
+    TEST_CHECK(Test_log[0] == '\0');
+    TEST_CHECK(strstr(output,"Batch done") == 0);
+
+    /* Lines beyond LOCCIONI_CLI_BATCH_SIZE discard the whole batch. */
+    Test_line("batch begin\r\n");
+    Test_send("add 7777777777777777777777777777\r\n");
+    Test_send("add 8888888888888888888888888888\r\n");
+    output = Test_send("batch end\r\n");
+    TEST_CHECK(Test_log[0] == '\0');
+    TEST_CHECK(strstr(output,"Batch too long") != 0);
+
+    return Test_result();
+}
@@ -0,0 +1,213 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*
+ * Framed protocol: SLIP frames with a CRC16 that the CLI checks on the
+ * requests and appends to the replies. The CRC is computed here bit by bit,
+ * independently of the table of cli.c. With the statistics, the framed
+ * calls must be counted by "stats".
+ */
+
+#include "cli.h"
+#include "cli-test.h"
+
+#define TEST_FRAME_SIZE              64
+
+typedef struct _Test_Frame
+{
+    uint8_t data[TEST_FRAME_SIZE];
+    uint16_t length;
+} Test_Frame;
+
+static int Test_calls = 0;
+
+static uint16_t Test_crc16 (const uint8_t* data, uint16_t length)
+{
+    uint16_t crc = 0xFFFF;
+    uint16_t i;
+    uint8_t bit;
+
+    for (i = 0; i < length; ++i)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (bit = 0; bit < 8; ++bit)
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    }
+    return crc;
+}
+
+static void Test_text (void* device, int argc, char* argv[])
+{
+    (void)device;
+    Test_calls++;
+    if (argc == 3)
+        Cli_printf("%s+%s",argv[1],argv[2]);
+}
+
+static uint8_t Test_echo (void* device, const uint8_t* data, uint16_t length)
+{
+    (void)device;
+    Test_calls++;
+    Cli_sendData(data,length);
+    return CLI_FRAMESTATUS_OK;
+}
+
+/**
+ * Encode and send a request, then decode the reply frame.
+ *
+ * @param corrupt Flip the last CRC byte
+ * @return FALSE when no reply frame with a good CRC is received
+ */
+static bool Test_request (uint8_t sequence, uint8_t id, const void* payload, uint16_t length,
+                          bool corrupt, Test_Frame* reply)
+{
+    uint8_t frame[TEST_FRAME_SIZE];
+    char encoded[2 * TEST_FRAME_SIZE + 2];
+    const char* output;
+    uint16_t size = 0;
+    uint16_t crc;
+    uint16_t i;
+    bool escape = FALSE;
+
+    frame[0] = sequence;
+    frame[1] = id;
+    memcpy(&frame[2],payload,length);
+    crc = Test_crc16(frame,length + 2);
+    frame[length + 2] = crc & 0xFF;
+    frame[length + 3] = (crc >> 8) ^ (corrupt ? 0x01 : 0x00);
+
+    for (i = 0; i < (length + 4); ++i)
+    {
+        if ((frame[i] == 0xC0) || (frame[i] == 0xDB))
+        {
+            encoded[size++] = (char)0xDB;
+            encoded[size++] = (frame[i] == 0xC0) ? (char)0xDC : (char)0xDD;
+        }
+        else
+        {
+            encoded[size++] = frame[i];
+        }
+    }
+    encoded[size++] = (char)0xC0;
+
+    Test_sendBytes(encoded,size);
+    output = Test_output;
+
+    /* The reply starts with an END that flushes the line noise. */
+    if ((uint8_t)output[0] != 0xC0)
+        return FALSE;
+    reply->length = 0;
+    for (i = 1; (i < Test_memory.outputLength) && ((uint8_t)output[i] != 0xC0); ++i)
+    {
+        uint8_t c = output[i];
+
+        if (escape)
+        {
+            c = (c == 0xDC) ? 0xC0 : 0xDB;
+            escape = FALSE;
+        }
+        else if (c == 0xDB)
+        {
+            escape = TRUE;
+            continue;
+        }
+        if (reply->length == TEST_FRAME_SIZE)
+            return FALSE;
+        reply->data[reply->length++] = c;
+    }
+
+    if ((i == Test_memory.outputLength) || (reply->length < 5))
+        return FALSE;
+    crc = Test_crc16(reply->data,reply->length - 2);
+    return (reply->data[reply->length - 2] == (crc & 0xFF)) &&
+           (reply->data[reply->length - 1] == (crc >> 8));
+}
+
+/** Status byte of a reply, before its CRC. */
+#define TEST_STATUS(reply)           ((reply).data[(reply).length - 3])
+
+int main (void)
+{
+    static const uint8_t binary[] = {0x01, 0xC0, 0xDB, 0x02};
+    static const char arguments[] = "12\0ab";
+    const char* output;
+    Test_Frame reply;
+    uint8_t textId;
+    uint8_t echoId;
+
+    Cli_registerCommand("text","Join two parameters",Test_text);
+    Cli_registerFramedCommand("echo","Return the payload",0,0,Test_echo);
+    Test_open();
+
+    Test_send("framed\r\n");
+    TEST_CHECK(Cli_isFramedMode());
+
+    TEST_CHECK(Test_request(1,CLI_FRAMEID_LOOKUP,"text",4,FALSE,&reply));
+    TEST_CHECK((reply.data[0] == 1) && (reply.data[1] == CLI_FRAMEID_LOOKUP));
+    TEST_CHECK((reply.length == 6) && (TEST_STATUS(reply) == CLI_FRAMESTATUS_OK));
+    textId = reply.data[2];
+
+    TEST_CHECK(Test_request(2,CLI_FRAMEID_LOOKUP,"echo",4,FALSE,&reply));
+    TEST_CHECK(TEST_STATUS(reply) == CLI_FRAMESTATUS_OK);
+    echoId = reply.data[2];
+
+    TEST_CHECK(Test_request(3,CLI_FRAMEID_LOOKUP,"none",4,FALSE,&reply));
+    TEST_CHECK(TEST_STATUS(reply) == CLI_FRAMESTATUS_UNKNOWN);
+
+    /* Text handler: null separated arguments, text output as data. */
+    TEST_CHECK(Test_request(4,textId,arguments,sizeof(arguments) - 1,FALSE,&reply));
+    TEST_CHECK((reply.data[0] == 4) && (reply.data[1] == textId));
+    TEST_CHECK(TEST_STATUS(reply) == CLI_FRAMESTATUS_OK);
+    TEST_CHECK((reply.length == 10) && (memcmp(&reply.data[2],"12+ab",5) == 0));
+
+    /* SLIP escapes in both directions. */
+    TEST_CHECK(Test_request(5,echoId,binary,sizeof(binary),FALSE,&reply));
+    TEST_CHECK(TEST_STATUS(reply) == CLI_FRAMESTATUS_OK);
+    TEST_CHECK((reply.length == 9) && (memcmp(&reply.data[2],binary,sizeof(binary)) == 0));
+
+    /* A bad CRC is reported and the handler is not run. */
+    Test_calls = 0;
+    TEST_CHECK(Test_request(6,echoId,binary,sizeof(binary),TRUE,&reply));
+    TEST_CHECK((reply.data[0] == 6) && (reply.length == 5));
+    TEST_CHECK(TEST_STATUS(reply) == CLI_FRAMESTATUS_CRC);
+    TEST_CHECK(Test_calls == 0);
+
+    TEST_CHECK(Test_request(7,CLI_FRAMEID_EXIT,"",0,FALSE,&reply));
+    TEST_CHECK(TEST_STATUS(reply) == CLI_FRAMESTATUS_OK);
+    TEST_CHECK(!Cli_isFramedMode());
+
+#if LOCCIONI_CLI_STATISTICS == 1
+    /* Binary handlers are counted like the text ones: once, the good CRC. */
+    output = strstr(Test_send("stats\r\n"),"\necho");
+    TEST_CHECK((output != 0) && (strncmp(strchr(output,':'),": 1, ",5) == 0));
+    output = strstr(Test_output,"\ntext");
+    TEST_CHECK((output != 0) && (strncmp(strchr(output,':'),": 1, ",5) == 0));
+#endif
+
+    return Test_result();
+}
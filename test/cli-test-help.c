@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*
+ * Paged help: every page from 1 to the last one is listed, any other
+ * number is refused, also when it would wrap into the 8 bit page.
+ */
+
+#include "cli.h"
+#include "cli-test.h"
+
+#include <stdlib.h>
+
+static bool Test_refused (unsigned long page)
+{
+    char line[32];
+
+    snprintf(line,sizeof(line),"help %lu\r\n",page);
+    return strstr(Test_send(line),"ERR: Wrong parameters") != 0;
+}
+
+int main (void)
+{
+    const char* output;
+    unsigned long pages = 0;
+    unsigned long page;
+    char text[32];
+
+    Test_open();
+
+    output = strstr(Test_send("help\r\n"),"Page 1/");
+    TEST_CHECK(output != 0);
+    if (output != 0)
+        pages = strtoul(output + 7,0,10);
+    TEST_CHECK(pages > 1);
+
+    for (page = 1; page <= pages; ++page)
+    {
+        snprintf(text,sizeof(text),"help %lu\r\n",page);
+        output = Test_send(text);
+        snprintf(text,sizeof(text),"Page %lu/%lu",page,pages);
+        TEST_CHECK(strstr(output,text) != 0);
+    }
+
+    TEST_CHECK(Test_refused(0));
+    TEST_CHECK(Test_refused(pages + 1));
+    TEST_CHECK(Test_refused(256));
+    TEST_CHECK(Test_refused(257));
+    TEST_CHECK(Test_refused(256 + pages));
+    TEST_CHECK(Test_refused(4294967297ul));
+
+    /* Not a number: the help of that command. */
+    TEST_CHECK(strstr(Test_send("help version\r\n"),"version") != 0);
+    TEST_CHECK(strstr(Test_send("help nothing\r\n"),"ERR") != 0);
+
+    return Test_result();
+}
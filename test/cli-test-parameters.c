@@ -0,0 +1,91 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*
+ * Integer parameters: "param set" must accept the whole range of the
+ * variable, signed or not, and refuse one past either end without
+ * touching the value.
+ */
+
+#include "cli.h"
+#include "cli-test.h"
+
+static int8_t Test_s8;
+static int16_t Test_s16;
+static uint8_t Test_u8;
+static uint16_t Test_h16;
+
+static const Cli_Argument Test_arguments[] =
+{
+    {.name = "s8" , .type = CLI_ARGTYPE_INT},
+    {.name = "s16", .type = CLI_ARGTYPE_INT},
+    {.name = "u8" , .type = CLI_ARGTYPE_INT, .min = 0, .max = 255},
+    {.name = "h16", .type = CLI_ARGTYPE_HEX},
+};
+
+/** Run "param set name value", return TRUE when it has been accepted. */
+static bool Test_set (const char* name, const char* value)
+{
+    char line[64];
+
+    snprintf(line,sizeof(line),"param set %s %s\r\n",name,value);
+    return strstr(Test_send(line),"ERR") == 0;
+}
+
+int main (void)
+{
+    TEST_CHECK(Cli_registerParameter(&Test_arguments[0],&Test_s8,1));
+    TEST_CHECK(Cli_registerParameter(&Test_arguments[1],&Test_s16,2));
+    TEST_CHECK(Cli_registerParameter(&Test_arguments[2],&Test_u8,1));
+    TEST_CHECK(Cli_registerParameter(&Test_arguments[3],&Test_h16,2));
+    Test_open();
+    Cli_setConfigMode(TRUE);
+
+    TEST_CHECK(Test_set("s8","127") && (Test_s8 == 127));
+    TEST_CHECK(!Test_set("s8","128") && (Test_s8 == 127));
+    TEST_CHECK(Test_set("s8","-128") && (Test_s8 == -128));
+    TEST_CHECK(!Test_set("s8","-129") && (Test_s8 == -128));
+    TEST_CHECK(strstr(Test_send("param get s8\r\n"),"-128") != 0);
+
+    TEST_CHECK(Test_set("s16","32767") && (Test_s16 == 32767));
+    TEST_CHECK(!Test_set("s16","32768") && (Test_s16 == 32767));
+    TEST_CHECK(Test_set("s16","-32768") && (Test_s16 == -32768));
+    TEST_CHECK(!Test_set("s16","-32769") && (Test_s16 == -32768));
+    TEST_CHECK(strstr(Test_send("param get s16\r\n"),"-32768") != 0);
+
+    /* A schema with min >= 0 makes the parameter unsigned. */
+    TEST_CHECK(Test_set("u8","255") && (Test_u8 == 255));
+    TEST_CHECK(!Test_set("u8","256") && (Test_u8 == 255));
+    TEST_CHECK(!Test_set("u8","-1") && (Test_u8 == 255));
+    TEST_CHECK(Test_set("u8","0") && (Test_u8 == 0));
+
+    TEST_CHECK(Test_set("h16","0xFFFF") && (Test_h16 == 0xFFFF));
+    TEST_CHECK(!Test_set("h16","0x10000") && (Test_h16 == 0xFFFF));
+
+    return Test_result();
+}
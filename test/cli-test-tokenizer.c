@@ -0,0 +1,97 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*
+ * Tokenizer: blanks separate the parameters, double quotes keep blanks and
+ * ';' inside a parameter and are not copied.
+ */
+
+#include "cli.h"
+#include "cli-test.h"
+
+#define TEST_MAX_ARGS                16
+
+static int Test_argc;
+static char Test_argv[TEST_MAX_ARGS][LOCCIONI_CLI_LINE_SIZE];
+
+static void Test_capture (void* device, int argc, char* argv[])
+{
+    int i;
+
+    (void)device;
+    Test_argc = argc;
+    for (i = 0; (i < argc) && (i < TEST_MAX_ARGS); ++i)
+        strcpy(Test_argv[i],argv[i]);
+}
+
+static void Test_line (const char* line)
+{
+    Test_argc = -1;
+    Test_send(line);
+}
+
+int main (void)
+{
+    Cli_registerCommand("cap","Capture the parameters",Test_capture);
+    Test_open();
+
+    Test_line("cap one two\r\n");
+    TEST_CHECK(Test_argc == 3);
+    TEST_CHECK(strcmp(Test_argv[0],"cap") == 0);
+    TEST_CHECK(strcmp(Test_argv[1],"one") == 0);
+    TEST_CHECK(strcmp(Test_argv[2],"two") == 0);
+
+    Test_line("  cap   spaced    out  \r\n");
+    TEST_CHECK(Test_argc == 3);
+    TEST_CHECK(strcmp(Test_argv[1],"spaced") == 0);
+    TEST_CHECK(strcmp(Test_argv[2],"out") == 0);
+
+    Test_line("cap \"hello world\" x\r\n");
+    TEST_CHECK(Test_argc == 3);
+    TEST_CHECK(strcmp(Test_argv[1],"hello world") == 0);
+    TEST_CHECK(strcmp(Test_argv[2],"x") == 0);
+
+    Test_line("cap \"a;b\"\r\n");
+    TEST_CHECK(Test_argc == 2);
+    TEST_CHECK(strcmp(Test_argv[1],"a;b") == 0);
+
+    Test_line("cap pre\"fix and\"post\r\n");
+    TEST_CHECK(Test_argc == 2);
+    TEST_CHECK(strcmp(Test_argv[1],"prefix andpost") == 0);
+
+    Test_line("cap \"\" end\r\n");
+    TEST_CHECK(Test_argc == 3);
+    TEST_CHECK(strcmp(Test_argv[1],"") == 0);
+    TEST_CHECK(strcmp(Test_argv[2],"end") == 0);
+
+    /* The name is matched as a whole token, not as a prefix. */
+    Test_line("capture x\r\n");
+    TEST_CHECK(Test_argc == -1);
+
+    return Test_result();
+}
@@ -0,0 +1,185 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*
+ * Round trip of a block through "upload" and "download": the CLI runs in a
+ * thread on one end of a socket pair, Cli_hostUpload and Cli_hostDownload
+ * on the other. The transport of the CLI flips a byte of chunk 2 once in
+ * every direction, so the block arrives only if the CRC refuses the chunk
+ * and it is sent again.
+ */
+
+#include "cli.h"
+#include "cli-test.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_BLOCK_SIZE              5000
+#define TEST_CORRUPTED_CHUNK         2
+
+/** Finds the first data byte of the corrupted chunk in a packet stream. */
+typedef struct _Test_Corrupter
+{
+    uint8_t header[5];
+    uint8_t index;
+    bool done;
+} Test_Corrupter;
+
+typedef struct _Test_Block
+{
+    uint8_t data[TEST_BLOCK_SIZE];
+    uint32_t committed;
+} Test_Block;
+
+static Test_Block Test_block;
+static Cli_Transport Test_base;
+static Cli_Transport Test_transport;
+static Test_Corrupter Test_received;
+static Test_Corrupter Test_sent;
+static volatile bool Test_stop = FALSE;
+
+static void Test_corrupt (Test_Corrupter* corrupter, char* data, uint16_t length)
+{
+    uint16_t i;
+
+    for (i = 0; (i < length) && !corrupter->done; ++i)
+    {
+        uint8_t c = data[i];
+
+        if (corrupter->index == 5)
+        {
+            data[i] ^= 0x55;
+            corrupter->done = TRUE;
+            break;
+        }
+        if ((corrupter->index == 0) && (c != CLI_TRANSFER_SYNC))
+            continue;
+
+        corrupter->header[corrupter->index++] = c;
+        if ((corrupter->index == 2) && (c != CLI_TRANSFER_DATA))
+            corrupter->index = 0;
+        else if ((corrupter->index == 4) &&
+                 ((corrupter->header[2] | (corrupter->header[3] << 8)) != TEST_CORRUPTED_CHUNK))
+            corrupter->index = 0;
+    }
+}
+
+static uint16_t Test_read (void* handle, char* data, uint16_t length)
+{
+    length = Test_base.read(handle,data,length);
+    Test_corrupt(&Test_received,data,length);
+    return length;
+}
+
+static uint16_t Test_write (void* handle, const char* data, uint16_t length)
+{
+    char copy[512];
+    Test_Corrupter state = Test_sent;
+
+    if (length > sizeof(copy))
+        length = sizeof(copy);
+    memcpy(copy,data,length);
+    Test_corrupt(&state,copy,length);
+
+    length = Test_base.write(handle,copy,length);
+    /* Only the bytes written move the corrupter on. */
+    memcpy(copy,data,length);
+    Test_corrupt(&Test_sent,copy,length);
+    return length;
+}
+
+static uint16_t Test_blockRead (void* device, uint32_t offset, uint8_t* data, uint16_t length)
+{
+    Test_Block* block = device;
+
+    memcpy(data,&block->data[offset],length);
+    return length;
+}
+
+static bool Test_blockWrite (void* device, uint32_t offset, const uint8_t* data, uint16_t length)
+{
+    Test_Block* block = device;
+
+    if (length == 0)
+        block->committed = offset;
+    else
+        memcpy(&block->data[offset],data,length);
+    return TRUE;
+}
+
+static void* Test_loop (void* argument)
+{
+    (void)argument;
+    while (!Test_stop)
+    {
+        Cli_check();
+        usleep(100);
+    }
+    return 0;
+}
+
+int main (void)
+{
+    static uint8_t source[TEST_BLOCK_SIZE];
+    static uint8_t received[TEST_BLOCK_SIZE];
+    Cli_HostFd fd;
+    int peer;
+    uint32_t length = 0;
+    pthread_t thread;
+    uint32_t i;
+
+    for (i = 0; i < TEST_BLOCK_SIZE; ++i)
+        source[i] = (i * 7) & 0x7F;
+
+    TEST_CHECK(Cli_hostOpenSocketPair(&fd,&peer) == ERRORS_NO_ERROR);
+    Cli_hostFdTransport(&Test_base,&fd);
+    Test_transport = Test_base;
+    Test_transport.read = Test_read;
+    Test_transport.write = Test_write;
+
+    TEST_CHECK(Cli_registerData("blob",&Test_block,TEST_BLOCK_SIZE,Test_blockRead,Test_blockWrite));
+    Cli_initTransport(&Test_transport);
+    pthread_create(&thread,0,Test_loop,0);
+
+    TEST_CHECK(Cli_hostUpload(peer,"blob",source,TEST_BLOCK_SIZE) == ERRORS_NO_ERROR);
+    TEST_CHECK(Test_received.done);
+    TEST_CHECK(Test_block.committed == TEST_BLOCK_SIZE);
+    TEST_CHECK(memcmp(Test_block.data,source,TEST_BLOCK_SIZE) == 0);
+
+    TEST_CHECK(Cli_hostDownload(peer,"blob",received,sizeof(received),&length) == ERRORS_NO_ERROR);
+    TEST_CHECK(Test_sent.done);
+    TEST_CHECK(length == TEST_BLOCK_SIZE);
+    TEST_CHECK(memcmp(received,source,TEST_BLOCK_SIZE) == 0);
+
+    Test_stop = TRUE;
+    pthread_join(thread,0);
+    close(peer);
+    return Test_result();
+}
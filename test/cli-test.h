@@ -0,0 +1,105 @@
+/******************************************************************************
+ * Copyright (C) 2015-2018 AEA s.r.l. Loccioni Group - Elctronic Design Dept.
+ *
+ * Authors:
+ *  Marco Giammarini <m.giammarini@loccioni.com>
+ *  Alessio Paolucci <a.paolucci89@gmail.com>
+ *  Matteo Piersantelli
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*
+ * Checks shared by the behaviour tests: a failed check is reported and the
+ * test goes on, main returns Test_result(). Test_open binds the CLI to a
+ * memory transport, Test_send runs a line and returns the output.
+ */
+
+#ifndef __LOCCIONI_CLI_TEST_H
+#define __LOCCIONI_CLI_TEST_H
+
+#include "cli.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_OUTPUT_SIZE             4096
+
+static int Test_failures = 0;
+
+#define TEST_CHECK(condition)                                                 \
+    do                                                                        \
+    {                                                                         \
+        if (!(condition))                                                     \
+        {                                                                     \
+            fprintf(stderr,"%s:%d: check failed: %s\n",__FILE__,__LINE__,#condition); \
+            Test_failures++;                                                  \
+        }                                                                     \
+    } while (0)
+
+static Cli_Transport Test_memoryTransport;
+static Cli_HostMemory Test_memory;
+static char Test_output[TEST_OUTPUT_SIZE];
+
+static inline void Test_open (void)
+{
+    Test_memory.output = Test_output;
+    Test_memory.outputSize = sizeof(Test_output) - 1;
+    Cli_hostMemoryTransport(&Test_memoryTransport,&Test_memory);
+    Cli_initTransport(&Test_memoryTransport);
+}
+
+/**
+ * Feed length bytes to the CLI and serve them, with the tasks they start.
+ *
+ * @return The output, null terminated
+ */
+static inline const char* Test_sendBytes (const char* data, uint32_t length)
+{
+    Test_memory.outputLength = 0;
+    Test_memory.input = data;
+    Test_memory.inputLength = length;
+    Test_memory.inputIndex = 0;
+
+    do
+    {
+        Cli_check();
+    } while ((Test_memory.inputIndex < length) || Cli_isTaskRunning());
+    Cli_flush();
+
+    if (Test_memory.outputLength > Test_memory.outputSize)
+        Test_memory.outputLength = Test_memory.outputSize;
+    Test_output[Test_memory.outputLength] = '\0';
+    return Test_output;
+}
+
+static inline const char* Test_send (const char* line)
+{
+    return Test_sendBytes(line,strlen(line));
+}
+
+static inline int Test_result (void)
+{
+    if (Test_failures > 0)
+        fprintf(stderr,"%d checks failed\n",Test_failures);
+    return (Test_failures > 0) ? 1 : 0;
+}
+
+#endif /* __LOCCIONI_CLI_TEST_H */